@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../core/JobSystem.hpp"
+#include "Clip.hpp"
+#include "Skeleton.hpp"
+#include "Skinning.hpp"
+
+namespace animation {
+    // Blocks of vertices one skinning task item covers
+    constexpr inline std::size_t SKIN_RANGE_BLOCKS = 32;
+
+    // Mesh is optional; when set, Skinned receives the mesh posed by Current after every Animate. An instance without
+    // an Animation is skipped entirely, keeping its last pose and skinned vertices
+    struct Instance {
+        const Clip* Animation = nullptr;
+        float Time = 0.f;
+        Pose Current;
+        const SkinnedMesh* Mesh = nullptr;
+        std::vector<shader::Vertex> Skinned;
+    };
+
+    // Samples and composes every pose, then skins every instance with a mesh. Each worker takes whole instances for
+    // the poses, then ranges of SKIN_RANGE_BLOCKS blocks from any mesh, so one large mesh spreads over all workers
+    inline void Animate(core::JobSystem& jobs, const Skeleton& skeleton, std::vector<Instance>& instances,
+                        const Interpolation mode = Interpolation::Slerp) {
+        struct Range {
+            Instance* Owner;
+            std::size_t FirstBlock;
+            std::size_t LastBlock;
+        };
+
+        std::vector<Range> ranges;
+        for(Instance& instance : instances) {
+            if(instance.Animation == nullptr || instance.Mesh == nullptr) continue;
+
+            const std::size_t blocks = instance.Mesh->GetBlockCount();
+            instance.Skinned.resize(instance.Mesh->Size());
+            for(std::size_t block = 0; block < blocks; block += SKIN_RANGE_BLOCKS) {
+                ranges.push_back({&instance, block, std::min(block + SKIN_RANGE_BLOCKS, blocks)});
+            }
+        }
+
+        std::atomic<std::size_t> nextPose{0};
+        std::atomic<std::size_t> nextRange{0};
+
+        core::TaskGraph graph;
+        std::vector<core::TaskId> poses;
+        for(std::size_t i = 0; i < jobs.GetWorkerCount(); ++i) {
+            poses.push_back(graph.Add("AnimatePoses", [&](std::size_t) {
+                for(std::size_t index = nextPose.fetch_add(1); index < instances.size();
+                    index = nextPose.fetch_add(1)) {
+                    Instance& instance = instances[index];
+                    if(instance.Animation == nullptr) continue;
+
+                    Sample(*instance.Animation, instance.Time, instance.Current, mode);
+                    ComposePalette(skeleton, instance.Current);
+                }
+            }));
+        }
+
+        if(!ranges.empty()) {
+            for(std::size_t i = 0; i < jobs.GetWorkerCount(); ++i) {
+                const core::TaskId skin = graph.Add("SkinVertices", [&](std::size_t) {
+                    for(std::size_t index = nextRange.fetch_add(1); index < ranges.size();
+                        index = nextRange.fetch_add(1)) {
+                        const Range& range = ranges[index];
+                        SkinBlocks(range.Owner->Current.Palette, *range.Owner->Mesh, range.FirstBlock,
+                                   range.LastBlock, range.Owner->Skinned);
+                    }
+                });
+                for(const core::TaskId pose : poses) graph.Depend(skin, pose);
+            }
+        }
+
+        jobs.Execute(graph);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "../math/Math.hpp"
+#include "Skeleton.hpp"
+
+namespace animation {
+    enum class Interpolation { Nlerp, Slerp };
+
+    // Keyframes of one joint, sorted by time
+    struct Track {
+        std::vector<float> Times;
+        std::vector<math::Quaternion> Rotations;
+        std::vector<math::Vector> Translations;
+    };
+
+    // Tracks resampled at a fixed rate: frame f holds the local transform of every joint at f / SampleRate
+    struct Clip {
+        float SampleRate = 30.f;
+        std::vector<math::Quaternions> Rotations;
+        std::vector<math::Vectors> Translations;
+
+        inline float GetDuration() const noexcept {
+            return Rotations.empty() ? 0.f : static_cast<float>(Rotations.size() - 1) / SampleRate;
+        }
+    };
+
+    inline math::Quaternion SampleRotation(const Track& track, const float time) noexcept {
+        const auto next = std::upper_bound(track.Times.begin(), track.Times.end(), time);
+        if(next == track.Times.begin()) return track.Rotations.front();
+        if(next == track.Times.end()) return track.Rotations.back();
+
+        const std::size_t key = static_cast<std::size_t>(next - track.Times.begin());
+        const float t = (time - track.Times[key - 1]) / (track.Times[key] - track.Times[key - 1]);
+        return track.Rotations[key - 1].Slerp(track.Rotations[key], t);
+    }
+
+    inline math::Vector SampleTranslation(const Track& track, const float time) noexcept {
+        const auto next = std::upper_bound(track.Times.begin(), track.Times.end(), time);
+        if(next == track.Times.begin()) return track.Translations.front();
+        if(next == track.Times.end()) return track.Translations.back();
+
+        const std::size_t key = static_cast<std::size_t>(next - track.Times.begin());
+        const float t = (time - track.Times[key - 1]) / (track.Times[key] - track.Times[key - 1]);
+        return track.Translations[key - 1] + (track.Translations[key] - track.Translations[key - 1]) * t;
+    }
+
+    // tracks[j] animates joint j; every track needs at least one key
+    inline Clip BuildClip(const std::vector<Track>& tracks, const float duration, const float sampleRate = 30.f) {
+        Clip clip;
+        clip.SampleRate = sampleRate;
+
+        const std::size_t frames = static_cast<std::size_t>(std::ceil(duration * sampleRate)) + 1;
+        clip.Rotations.assign(frames, math::Quaternions(tracks.size()));
+        clip.Translations.assign(frames, math::Vectors(tracks.size()));
+
+        for(std::size_t frame = 0; frame < frames; ++frame) {
+            const float time = std::min(duration, static_cast<float>(frame) / sampleRate);
+
+            for(std::size_t joint = 0; joint < tracks.size(); ++joint) {
+                assert(!tracks[joint].Times.empty() && "Track without keyframes");
+                clip.Rotations[frame].Set(joint, SampleRotation(tracks[joint], time));
+                clip.Translations[frame].Set(joint, SampleTranslation(tracks[joint], time));
+            }
+        }
+
+        return clip;
+    }
+
+    // Blends the two frames around time for every joint at once; time wraps around the clip
+    inline void Sample(const Clip& clip, const float time, Pose& pose,
+                       const Interpolation mode = Interpolation::Slerp) {
+        assert(!clip.Rotations.empty() && "Sampling an empty clip");
+
+        const std::size_t last = clip.Rotations.size() - 1;
+        if(last == 0) {
+            pose.Rotations = clip.Rotations[0];
+            pose.Translations = clip.Translations[0];
+            return;
+        }
+
+        const float frames = static_cast<float>(last);
+        float position = std::fmod(time * clip.SampleRate, frames);
+        if(position < 0.f) position += frames;
+
+        const std::size_t frame = std::min(last - 1, static_cast<std::size_t>(position));
+        const float t = position - static_cast<float>(frame);
+
+        if(mode == Interpolation::Slerp) {
+            math::SlerpQuaternions(clip.Rotations[frame], clip.Rotations[frame + 1], t, pose.Rotations);
+        } else {
+            math::NlerpQuaternions(clip.Rotations[frame], clip.Rotations[frame + 1], t, pose.Rotations);
+        }
+
+        math::LerpVectors(clip.Translations[frame], clip.Translations[frame + 1], t, pose.Translations);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "../math/Math.hpp"
+
+namespace animation {
+    // Joints are stored parents first, so a single forward pass composes the whole hierarchy
+    struct Skeleton {
+        std::vector<std::int32_t> Parents;
+        std::vector<math::Matrix> InverseBindPoses;
+
+        inline std::size_t GetJointCount() const noexcept { return Parents.size(); }
+    };
+
+    // Local joint transforms of one instance and the palette composed from them; kept between frames for reuse
+    struct Pose {
+        math::Quaternions Rotations;
+        math::Vectors Translations;
+        math::Matrices Locals;
+        std::vector<math::Matrix> Models;
+        math::Matrices Palette;
+    };
+
+    // Palette joint j takes a bind-pose vertex to joint j's current model-space placement
+    inline void ComposePalette(const Skeleton& skeleton, Pose& pose) {
+        const std::size_t count = skeleton.GetJointCount();
+
+        math::ComposeTransforms(pose.Rotations, pose.Translations, pose.Locals);
+        pose.Models.resize(count);
+        pose.Palette.Resize(count);
+
+        for(std::size_t joint = 0; joint < count; ++joint) {
+            const std::int32_t parent = skeleton.Parents[joint];
+            assert(parent < static_cast<std::int32_t>(joint) && "Parents must precede their children");
+
+            const math::Matrix local = pose.Locals.Get(joint);
+            pose.Models[joint] = parent < 0 ? local : pose.Models[parent] * local;
+            pose.Palette.Set(joint, pose.Models[joint] * skeleton.InverseBindPoses[joint]);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "../graphics/Rasterizer.hpp"
+#include "../math/Math.hpp"
+
+// SkinKernel takes the wide lane types of math::Batch, flattened into one target the same way
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace animation {
+    constexpr inline int MAX_JOINT_WEIGHTS = 4;
+
+    // Unused influences carry a zero weight; weights of a vertex sum to one
+    struct SkinnedVertex {
+        math::Vector Pos;
+        math::Vector Color;
+        std::uint16_t Joints[MAX_JOINT_WEIGHTS];
+        float Weights[MAX_JOINT_WEIGHTS];
+    };
+
+    // Skinning input in blocked SoA form, built once per mesh. Weights stores influence k as component k, and
+    // JointOffsets holds BATCH_LANES palette offsets per block and influence, ready to gather from a math::Matrices
+    struct SkinnedMesh {
+        math::Vectors Positions;
+        math::Vectors Weights;
+        std::vector<std::int32_t> JointOffsets;
+        std::vector<math::Vector> Colors;
+
+        inline std::size_t Size() const noexcept { return Positions.Size(); }
+        inline std::size_t GetBlockCount() const noexcept { return Positions.GetBlockCount(); }
+    };
+
+    static_assert(MAX_JOINT_WEIGHTS == 4, "SkinnedMesh stores the weights of a vertex as one Vector");
+
+    inline SkinnedMesh BuildSkinnedMesh(const std::vector<SkinnedVertex>& vertices) {
+        constexpr std::size_t lanes = math::BATCH_LANES;
+
+        SkinnedMesh mesh;
+        mesh.Positions.Resize(vertices.size());
+        mesh.Weights.Resize(vertices.size());
+        mesh.JointOffsets.assign(mesh.GetBlockCount() * MAX_JOINT_WEIGHTS * lanes, 0);
+        mesh.Colors.resize(vertices.size());
+
+        for(std::size_t i = 0; i < vertices.size(); ++i) {
+            const SkinnedVertex& vertex = vertices[i];
+            mesh.Positions.Set(i, vertex.Pos);
+            mesh.Weights.Set(i, math::Vector(vertex.Weights[0], vertex.Weights[1], vertex.Weights[2],
+                                             vertex.Weights[3]));
+            mesh.Colors[i] = vertex.Color;
+
+            // Element e of joint j lives at e * lanes plus this offset inside the palette batch
+            for(int influence = 0; influence < MAX_JOINT_WEIGHTS; ++influence) {
+                const std::size_t joint = vertex.Joints[influence];
+                mesh.JointOffsets[(i / lanes * MAX_JOINT_WEIGHTS + influence) * lanes + i % lanes] =
+                    static_cast<std::int32_t>(joint / lanes * 16 * lanes + joint % lanes);
+            }
+        }
+
+        return mesh;
+    }
+
+    // Linear blend skinning of blocks [firstBlock, lastBlock), Lanes::Width vertices per step: every lane gathers
+    // the palette elements of its own joints, the blended matrices then move the bind-pose positions
+    template <typename Lanes>
+    inline void SkinKernel(const math::Matrices& palette, const SkinnedMesh& mesh, const std::size_t firstBlock,
+                           const std::size_t lastBlock, shader::Vertex* out) noexcept {
+        constexpr std::size_t lanes = math::BATCH_LANES;
+        const typename Lanes::Type zero = Lanes::Set(0.f);
+
+        for(std::size_t block = firstBlock; block < lastBlock; ++block) {
+            for(std::size_t lane = 0; lane < lanes; lane += Lanes::Width) {
+                const std::size_t first = block * lanes + lane;
+                if(first >= mesh.Size()) break;
+
+                const float* weights = mesh.Weights.GetBlock(block) + lane;
+                const std::int32_t* joints = mesh.JointOffsets.data() + block * MAX_JOINT_WEIGHTS * lanes + lane;
+
+                typename Lanes::Type blended[16];
+                for(int i = 0; i < 16; ++i) blended[i] = zero;
+
+                for(int influence = 0; influence < MAX_JOINT_WEIGHTS; ++influence) {
+                    const typename Lanes::Type weight = Lanes::Load(weights + lanes * influence);
+                    const std::int32_t* offsets = joints + lanes * influence;
+
+                    for(int i = 0; i < 16; ++i) {
+                        const typename Lanes::Type element = Lanes::Gather(palette.Data.data() + lanes * i, offsets);
+                        blended[i] = Lanes::Add(blended[i], Lanes::Mul(element, weight));
+                    }
+                }
+
+                const float* src = mesh.Positions.GetBlock(block) + lane;
+                const typename Lanes::Type x = Lanes::Load(src);
+                const typename Lanes::Type y = Lanes::Load(src + lanes);
+                const typename Lanes::Type z = Lanes::Load(src + lanes * 2);
+                const typename Lanes::Type w = Lanes::Load(src + lanes * 3);
+
+                float pos[4][Lanes::Width];
+                for(int row = 0; row < 4; ++row) {
+                    typename Lanes::Type res = Lanes::Mul(blended[row], x);
+                    res = Lanes::Add(res, Lanes::Mul(blended[4 + row], y));
+                    res = Lanes::Add(res, Lanes::Mul(blended[8 + row], z));
+                    res = Lanes::Add(res, Lanes::Mul(blended[12 + row], w));
+                    Lanes::Store(pos[row], res);
+                }
+
+                const std::size_t count = std::min(Lanes::Width, mesh.Size() - first);
+                for(std::size_t i = 0; i < count; ++i) {
+                    out[first + i] = {math::Vector(pos[0][i], pos[1][i], pos[2][i], pos[3][i]), mesh.Colors[first + i]};
+                }
+            }
+        }
+    }
+
+    // Skins blocks [firstBlock, lastBlock) of mesh into out, which already holds mesh.Size() vertices; disjoint
+    // block ranges of one mesh may run concurrently
+    inline void SkinBlocks(const math::Matrices& palette, const SkinnedMesh& mesh, const std::size_t firstBlock,
+                           const std::size_t lastBlock, std::vector<shader::Vertex>& out) {
+        assert(palette.Size() > 0 && out.size() == mesh.Size());
+        math::Dispatch(
+            [&](auto lanes) { SkinKernel<decltype(lanes)>(palette, mesh, firstBlock, lastBlock, out.data()); });
+    }
+
+    inline void Skin(const math::Matrices& palette, const SkinnedMesh& mesh, std::vector<shader::Vertex>& out) {
+        out.resize(mesh.Size());
+        SkinBlocks(palette, mesh, 0, mesh.GetBlockCount(), out);
+    }
+
+    // skinned is scratch storage for the posed vertices, reused between calls
+    template <typename Shader>
+    inline void RenderSkinned(graphics::FrameBuffer& frame, const Shader& shader, const math::Matrices& palette,
+                              const SkinnedMesh& mesh, const std::vector<std::uint32_t>& indices,
+                              std::vector<shader::Vertex>& skinned) {
+        Skin(palette, mesh, skinned);
+        graphics::Render(frame, shader, skinned, indices);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
\ No newline at end of file
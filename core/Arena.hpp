@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace core {
+    constexpr inline std::size_t ARENA_BLOCK_SIZE = 1 << 20;
+
+    // Bump allocator for memory that lives until the next Reset or Rewind. Blocks are kept across resets, so once
+    // the arena has grown to a frame's peak, later frames never touch the heap. Nothing placed here is destroyed
+    class Arena {
+    public:
+        struct Marker {
+            std::size_t Block;
+            std::size_t Offset;
+        };
+
+        explicit Arena(const std::size_t blockSize = ARENA_BLOCK_SIZE) noexcept : blockSize(blockSize) {}
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&&) noexcept = default;
+        Arena& operator=(Arena&&) noexcept = default;
+
+        inline void* Allocate(const std::size_t bytes, const std::size_t alignment = alignof(std::max_align_t)) {
+            for(;; ++current, offset = 0) {
+                if(current == blocks.size()) {
+                    const std::size_t size = std::max(blockSize, bytes + alignment);
+                    blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+                }
+
+                Block& block = blocks[current];
+                const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.Data.get());
+                const std::size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+                if(start + bytes <= block.Size) {
+                    offset = start + bytes;
+                    return block.Data.get() + start;
+                }
+            }
+        }
+
+        // Storage for count objects of an implicit-lifetime type, left uninitialized
+        template <typename T> inline T* Allocate(const std::size_t count) {
+            static_assert(std::is_trivially_destructible_v<T>, "Arena memory is released without running destructors");
+            return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        inline Marker GetMarker() const noexcept { return {current, offset}; }
+        inline void Rewind(const Marker& marker) noexcept {
+            current = marker.Block;
+            offset = marker.Offset;
+        }
+
+        inline void Reset() noexcept { Rewind({0, 0}); }
+
+        inline std::size_t GetCapacity() const noexcept {
+            std::size_t capacity = 0;
+            for(const Block& block : blocks) capacity += block.Size;
+            return capacity;
+        }
+
+    private:
+        struct Block {
+            std::unique_ptr<std::byte[]> Data;
+            std::size_t Size;
+        };
+
+        std::vector<Block> blocks;
+        std::size_t current = 0;
+        std::size_t offset = 0;
+        std::size_t blockSize;
+    };
+
+    // Gives back everything allocated from the arena while the scope was alive
+    class ArenaScope {
+    public:
+        explicit ArenaScope(Arena& arena) noexcept : arena(arena), marker(arena.GetMarker()) {}
+        ~ArenaScope() { arena.Rewind(marker); }
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+    private:
+        Arena& arena;
+        Arena::Marker marker;
+    };
+}
\ No newline at end of file
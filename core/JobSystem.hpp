@@ -0,0 +1,301 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Parallel.hpp"
+#include "Trace.hpp"
+
+namespace core {
+    using TaskId = std::size_t;
+
+    // Tasks and their dependencies, built once and executed as many times as needed. A task can only depend on tasks
+    // added before it, so every graph is acyclic by construction
+    class TaskGraph {
+    public:
+        // run receives the index of the worker executing it; main-thread tasks always run on the thread calling
+        // JobSystem::Execute, which is worker 0. name is traced as given, so it must outlive the trace export
+        inline TaskId Add(const char* name, std::function<void(std::size_t worker)> run,
+                          const std::initializer_list<TaskId> dependencies = {}, const bool mainThread = false) {
+            const TaskId id = tasks.size();
+            tasks.push_back({name, std::move(run), {}, 0, mainThread});
+
+            for(const TaskId dependency : dependencies) Depend(id, dependency);
+            return id;
+        }
+
+        inline void Depend(const TaskId task, const TaskId dependency) {
+            assert(dependency < task && "A task can only wait on tasks added before it");
+
+            tasks[dependency].Dependents.push_back(task);
+            ++tasks[task].DependencyCount;
+        }
+
+        inline void Clear() noexcept { tasks.clear(); }
+        inline std::size_t GetTaskCount() const noexcept { return tasks.size(); }
+
+    private:
+        friend class JobSystem;
+
+        struct Task {
+            const char* Name;
+            std::function<void(std::size_t)> Run;
+            std::vector<TaskId> Dependents;
+            std::uint32_t DependencyCount;
+            bool MainThread;
+        };
+
+        std::vector<Task> tasks;
+    };
+
+    // Persistent workers with one deque each: a worker pops its newest task and steals the oldest from the others
+    // when it runs dry. Finishing a task releases the dependents it was the last dependency of onto the same worker
+    class JobSystem {
+    public:
+        explicit JobSystem(const std::size_t workers = core::GetWorkerCount()) {
+            const std::size_t count = std::max<std::size_t>(1, workers);
+
+            for(std::size_t i = 0; i < count; ++i) queues.push_back(std::make_unique<Queue>());
+            for(std::size_t i = 1; i < count; ++i) threads.emplace_back([this, i] { Work(i); });
+        }
+
+        ~JobSystem() {
+            {
+                const std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for(std::thread& thread : threads) thread.join();
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        inline std::size_t GetWorkerCount() const noexcept { return queues.size(); }
+
+        // Runs every task of graph once, with the calling thread working as worker 0, and returns when all are done.
+        // Only one graph executes at a time
+        inline void Execute(TaskGraph& graph) {
+            [[maybe_unused]] const bool busy = running.exchange(true, std::memory_order_acquire);
+            assert(!busy && "Only one graph executes at a time");
+
+            Drain(graph);
+            running.store(false, std::memory_order_release);
+        }
+
+        // Runs function(i) for every i in [0, count), each index picked up by the next idle worker, with the caller
+        // working as worker 0. Called from a task, or while another graph executes, it runs on its caller alone
+        template <typename Function> inline void For(const std::size_t count, Function&& function) {
+            if(queues.size() == 1 || count <= 1 || running.exchange(true, std::memory_order_acquire)) {
+                for(std::size_t i = 0; i < count; ++i) function(i);
+                return;
+            }
+
+            using Callable = std::remove_reference_t<Function>;
+            loop = {[](void* context, const std::size_t i) { (*static_cast<Callable*>(context))(i); },
+                    const_cast<void*>(static_cast<const void*>(std::addressof(function))), count};
+            loopNext.store(0, std::memory_order_relaxed);
+
+            // One task per worker, built on first use and kept, each pulling indices until the loop runs out
+            if(loopGraph.GetTaskCount() == 0) {
+                for(std::size_t i = 0; i < queues.size(); ++i) {
+                    loopGraph.Add("ParallelFor", [this](std::size_t) {
+                        for(std::size_t index = loopNext.fetch_add(1, std::memory_order_relaxed); index < loop.Count;
+                            index = loopNext.fetch_add(1, std::memory_order_relaxed))
+                            loop.Invoke(loop.Context, index);
+                    });
+                }
+            }
+
+            Drain(loopGraph);
+            running.store(false, std::memory_order_release);
+        }
+
+    private:
+        struct Queue {
+            std::mutex Mutex;
+            std::deque<TaskId> Tasks;
+        };
+
+        struct Loop {
+            void (*Invoke)(void* context, std::size_t i);
+            void* Context;
+            std::size_t Count;
+        };
+
+        inline void Drain(TaskGraph& graph) {
+            TRACE_SCOPE("ExecuteGraph");
+
+            const std::size_t count = graph.tasks.size();
+            if(count == 0) return;
+
+            current = &graph;
+            if(count > pendingCapacity) {
+                pending = std::make_unique<std::atomic<std::uint32_t>[]>(count);
+                pendingCapacity = count;
+            }
+            remaining.store(count, std::memory_order_relaxed);
+
+            // Every counter is set before the first root is pushed, since a worker may finish that root right away
+            for(TaskId id = 0; id < count; ++id) {
+                pending[id].store(graph.tasks[id].DependencyCount, std::memory_order_relaxed);
+            }
+
+            std::size_t next = 0;
+            for(TaskId id = 0; id < count; ++id) {
+                if(graph.tasks[id].DependencyCount == 0) Push(next++ % queues.size(), id);
+            }
+
+            for(;;) {
+                TaskId id;
+                if(PopMain(id) || Pop(0, id) || Steal(0, id)) {
+                    Run(0, id);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this] {
+                    return remaining.load(std::memory_order_acquire) == 0 || HasWork(true);
+                });
+
+                if(remaining.load(std::memory_order_acquire) == 0) break;
+            }
+
+            current = nullptr;
+        }
+
+        inline bool HasWork(const bool mainThread) const noexcept {
+            return queued.load(std::memory_order_acquire) > 0 ||
+                   (mainThread && mainQueued.load(std::memory_order_acquire) > 0);
+        }
+
+        inline void Push(const std::size_t worker, const TaskId id) {
+            if(current->tasks[id].MainThread) {
+                {
+                    const std::lock_guard<std::mutex> lock(mainQueue.Mutex);
+                    mainQueue.Tasks.push_back(id);
+                }
+                mainQueued.fetch_add(1, std::memory_order_release);
+            } else {
+                {
+                    const std::lock_guard<std::mutex> lock(queues[worker]->Mutex);
+                    queues[worker]->Tasks.push_back(id);
+                }
+                queued.fetch_add(1, std::memory_order_release);
+            }
+
+            // Taking the lock orders this push before any worker that is about to sleep re-checks its predicate
+            { const std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_all();
+        }
+
+        inline bool PopMain(TaskId& id) {
+            if(mainQueued.load(std::memory_order_acquire) == 0) return false;
+
+            const std::lock_guard<std::mutex> lock(mainQueue.Mutex);
+            if(mainQueue.Tasks.empty()) return false;
+
+            id = mainQueue.Tasks.front();
+            mainQueue.Tasks.pop_front();
+            mainQueued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        inline bool Pop(const std::size_t worker, TaskId& id) {
+            Queue& queue = *queues[worker];
+            const std::lock_guard<std::mutex> lock(queue.Mutex);
+            if(queue.Tasks.empty()) return false;
+
+            id = queue.Tasks.back();
+            queue.Tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        inline bool Steal(const std::size_t worker, TaskId& id) {
+            for(std::size_t offset = 1; offset < queues.size(); ++offset) {
+                Queue& queue = *queues[(worker + offset) % queues.size()];
+                const std::lock_guard<std::mutex> lock(queue.Mutex);
+                if(queue.Tasks.empty()) continue;
+
+                id = queue.Tasks.front();
+                queue.Tasks.pop_front();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            return false;
+        }
+
+        inline void Run(const std::size_t worker, const TaskId id) {
+            const TaskGraph::Task& task = current->tasks[id];
+            {
+                TRACE_SCOPE(task.Name);
+                task.Run(worker);
+            }
+
+            for(const TaskId dependent : task.Dependents) {
+                if(pending[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) Push(worker, dependent);
+            }
+
+            if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                { const std::lock_guard<std::mutex> lock(sleepMutex); }
+                wake.notify_all();
+            }
+        }
+
+        inline void Work(const std::size_t worker) {
+            for(;;) {
+                TaskId id;
+                if(Pop(worker, id) || Steal(worker, id)) {
+                    Run(worker, id);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this] { return stopping || HasWork(false); });
+                if(stopping) return;
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        Queue mainQueue;
+        std::vector<std::thread> threads;
+
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        std::atomic<std::size_t> queued{0};
+        std::atomic<std::size_t> mainQueued{0};
+        std::atomic<std::size_t> remaining{0};
+
+        TaskGraph* current = nullptr;
+        std::unique_ptr<std::atomic<std::uint32_t>[]> pending;
+        std::size_t pendingCapacity = 0;
+        std::atomic<bool> running{false};
+
+        TaskGraph loopGraph;
+        Loop loop{};
+        std::atomic<std::size_t> loopNext{0};
+    };
+
+    // Process-wide workers, shared by every pipeline stage that is not handed a JobSystem of its own
+    inline JobSystem& GetJobSystem() {
+        static JobSystem jobs;
+        return jobs;
+    }
+}
\ No newline at end of file
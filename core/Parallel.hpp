@@ -0,0 +1,9 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+namespace core {
+    inline std::uint32_t GetWorkerCount() noexcept { return std::max(1u, std::thread::hardware_concurrency()); }
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// TRACE_SCOPE(name) records the enclosing scope when built with ENGINE_TRACE and compiles to nothing otherwise.
+// Only the pointer is buffered, so name must outlive the trace export; string literals always do
+#ifdef ENGINE_TRACE
+#define ENGINE_TRACE_CONCAT_IMPL(a, b) a##b
+#define ENGINE_TRACE_CONCAT(a, b) ENGINE_TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) const core::TraceScope ENGINE_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+namespace core {
+    constexpr inline std::size_t TRACE_BUFFER_SIZE = 1 << 14;
+
+    struct TraceEvent {
+        const char* Name;
+        std::uint64_t Start;
+        std::uint64_t Duration;
+        std::uint32_t Thread;
+    };
+
+    // Written only by the thread that claimed it, so recording is a plain store and a release of Head; once full it
+    // overwrites its oldest events. A buffer is released when its thread exits and reused by the next new thread
+    struct TraceBuffer {
+        TraceEvent Events[TRACE_BUFFER_SIZE];
+        std::atomic<std::uint64_t> Head{0};
+        std::atomic<bool> Claimed{true};
+        TraceBuffer* Next = nullptr;
+    };
+
+    // Buffers are only ever pushed, never unlinked, so readers can walk the list without a lock
+    inline std::atomic<TraceBuffer*>& GetTraceBuffers() noexcept {
+        static std::atomic<TraceBuffer*> buffers{nullptr};
+        return buffers;
+    }
+
+    inline TraceBuffer* ClaimTraceBuffer() {
+        std::atomic<TraceBuffer*>& buffers = GetTraceBuffers();
+
+        for(TraceBuffer* buffer = buffers.load(std::memory_order_acquire); buffer; buffer = buffer->Next) {
+            bool claimed = false;
+            if(buffer->Claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire)) return buffer;
+        }
+
+        TraceBuffer* buffer = new TraceBuffer;
+        buffer->Next = buffers.load(std::memory_order_relaxed);
+        while(!buffers.compare_exchange_weak(buffer->Next, buffer, std::memory_order_release)) {}
+
+        return buffer;
+    }
+
+    struct ThreadTrace {
+        TraceBuffer* Buffer = ClaimTraceBuffer();
+        std::uint32_t Thread = NextThread().fetch_add(1, std::memory_order_relaxed);
+
+        ~ThreadTrace() { Buffer->Claimed.store(false, std::memory_order_release); }
+
+        static std::atomic<std::uint32_t>& NextThread() noexcept {
+            static std::atomic<std::uint32_t> next{0};
+            return next;
+        }
+    };
+
+    inline ThreadTrace& GetThreadTrace() {
+        thread_local ThreadTrace trace;
+        return trace;
+    }
+
+    inline std::uint64_t GetTraceTime() noexcept {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    }
+
+    inline void RecordTrace(const char* name, const std::uint64_t start, const std::uint64_t end) {
+        ThreadTrace& trace = GetThreadTrace();
+        TraceBuffer& buffer = *trace.Buffer;
+
+        const std::uint64_t head = buffer.Head.load(std::memory_order_relaxed);
+        buffer.Events[head % TRACE_BUFFER_SIZE] = {name, start, end - start, trace.Thread};
+        buffer.Head.store(head + 1, std::memory_order_release);
+    }
+
+    class TraceScope {
+    public:
+        explicit TraceScope(const char* name) noexcept : name(name), start(GetTraceTime()) {}
+        ~TraceScope() { RecordTrace(name, start, GetTraceTime()); }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* name;
+        std::uint64_t start;
+    };
+
+    // Writes every buffered event as Chrome trace JSON, loadable in chrome://tracing or Perfetto. Events recorded
+    // while exporting may come out torn, so export between frames
+    inline bool ExportTrace(const char* path) {
+        std::FILE* file = std::fopen(path, "w");
+        if(!file) return false;
+
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        bool first = true;
+
+        for(TraceBuffer* buffer = GetTraceBuffers().load(std::memory_order_acquire); buffer; buffer = buffer->Next) {
+            const std::uint64_t head = buffer->Head.load(std::memory_order_acquire);
+            const std::uint64_t begin = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+
+            for(std::uint64_t i = begin; i < head; ++i) {
+                const TraceEvent& event = buffer->Events[i % TRACE_BUFFER_SIZE];
+                std::fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                             first ? "" : ",", event.Name, event.Thread, static_cast<double>(event.Start) * 1e-3,
+                             static_cast<double>(event.Duration) * 1e-3);
+                first = false;
+            }
+        }
+
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+}
\ No newline at end of file
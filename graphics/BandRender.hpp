@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "../core/Trace.hpp"
+#include "FrameBuffer.hpp"
+
+namespace graphics {
+    constexpr inline std::uint32_t RENDER_BAND_HEIGHT = 256;
+
+    // Renders a width x height image in horizontal bands through one band-sized frame, so color and depth memory
+    // stays proportional to the band rather than the image. Each band is drawn with the full-image viewport and
+    // scissored to its rows, which makes every finished row identical to the same row of a full-frame render
+    class BandRenderer {
+    public:
+        BandRenderer(const std::uint32_t width, const std::uint32_t height,
+                     const std::uint32_t bandHeight = RENDER_BAND_HEIGHT)
+            : frame(width, std::clamp(bandHeight, 1u, std::max(height, 1u))), width(width), height(height) {}
+
+        // draw(frame) issues the whole scene once per band in image coordinates. onRows(firstRow, rowCount, colors)
+        // then receives the band's finished rows, top to bottom, and returns false to stop early
+        template <typename Draw, typename Rows>
+        inline bool Render(const std::uint32_t clearColor, Draw&& draw, Rows&& onRows) {
+            TRACE_SCOPE("BandRender");
+
+            for(std::uint32_t y = 0; y < height; y += frame.GetHeight()) {
+                frame.SetBand(y, height);
+                frame.Clear(clearColor);
+
+                draw(frame);
+
+                const std::uint32_t rows = std::min(frame.GetHeight(), height - y);
+                if(!onRows(y, rows, static_cast<const FrameBuffer&>(frame).GetColor())) return false;
+            }
+
+            return true;
+        }
+
+        inline std::uint32_t GetWidth() const noexcept { return width; }
+        inline std::uint32_t GetHeight() const noexcept { return height; }
+        inline std::uint32_t GetBandHeight() const noexcept { return frame.GetHeight(); }
+
+        inline std::uint32_t GetBandCount() const noexcept {
+            return (height + frame.GetHeight() - 1) / frame.GetHeight();
+        }
+
+    private:
+        FrameBuffer frame;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "../core/JobSystem.hpp"
+#include "../core/Trace.hpp"
+#include "../math/Math.hpp"
+#include "FrameBuffer.hpp"
+#include "PipelineState.hpp"
+#include "Rasterizer.hpp"
+#include "RenderContext.hpp"
+#include "Shader.hpp"
+
+namespace graphics {
+    struct BatchObject {
+        const std::vector<shader::Vertex>* Vertices;
+        const std::vector<std::uint32_t>* Indices;
+        math::Matrix Model;
+    };
+
+    struct BatchStats {
+        std::size_t Views = 0;
+        double Seconds = 0.0;
+        double FramesPerSecond = 0.0;
+    };
+
+    // Renders one scene from many cameras at once. Every worker owns a pooled frame and arena and renders whole
+    // views, taking the next one as soon as it is done; model transforms are applied once per scene and shared
+    class BatchRenderer {
+    public:
+        BatchRenderer(core::JobSystem& jobs, const std::uint32_t width, const std::uint32_t height)
+            : jobs(jobs), width(width), height(height) {
+            for(std::size_t i = 0; i < jobs.GetWorkerCount(); ++i) {
+                frames.emplace_back(width, height);
+                contexts.emplace_back(1);
+            }
+        }
+
+        // Moves every object into world space; the result is read by all views until the next call
+        inline void SetScene(const std::vector<BatchObject>& objects) {
+            TRACE_SCOPE("SetScene");
+
+            worldVertices.resize(objects.size());
+            indices.resize(objects.size());
+
+            for(std::size_t i = 0; i < objects.size(); ++i) {
+                const std::vector<shader::Vertex>& vertices = *objects[i].Vertices;
+
+                worldVertices[i].resize(vertices.size());
+                for(std::size_t v = 0; v < vertices.size(); ++v) {
+                    worldVertices[i][v] = {objects[i].Model * vertices[v].Pos, vertices[v].Color};
+                }
+                indices[i] = objects[i].Indices;
+            }
+        }
+
+        // Renders the scene once per view-projection matrix. onFrame(view, frame) runs on the worker that rendered
+        // the view, right after it finishes and before the frame is reused, so it must be safe to call concurrently
+        template <PipelineState State = PipelineState{}, typename Function>
+        inline BatchStats Render(const std::vector<math::Matrix>& viewProjections, const std::uint32_t clearColor,
+                                 Function&& onFrame) {
+            TRACE_SCOPE("BatchRender");
+
+            const math::Matrix viewport = math::CreateViewport(static_cast<float>(width), static_cast<float>(height));
+            std::atomic<std::size_t> next{0};
+
+            core::TaskGraph graph;
+            for(std::size_t i = 0; i < jobs.GetWorkerCount(); ++i) {
+                graph.Add("RenderViews", [&](const std::size_t worker) {
+                    FrameBuffer& frame = frames[worker];
+                    RenderContext& context = contexts[worker];
+
+                    for(std::size_t view = next.fetch_add(1); view < viewProjections.size();
+                        view = next.fetch_add(1)) {
+                        const shader::Default shader{viewProjections[view], viewport};
+
+                        frame.Clear(clearColor);
+                        for(std::size_t object = 0; object < worldVertices.size(); ++object) {
+                            graphics::Render<State>(frame, shader, worldVertices[object], *indices[object],
+                                                    PrimitiveType::Triangles, context);
+                        }
+
+                        onFrame(view, static_cast<const FrameBuffer&>(frame));
+                        context.EndFrame();
+                    }
+                });
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            jobs.Execute(graph);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            return {viewProjections.size(), seconds,
+                    seconds > 0.0 ? static_cast<double>(viewProjections.size()) / seconds : 0.0};
+        }
+
+        inline std::uint32_t GetWidth() const noexcept { return width; }
+        inline std::uint32_t GetHeight() const noexcept { return height; }
+
+    private:
+        core::JobSystem& jobs;
+        std::uint32_t width;
+        std::uint32_t height;
+
+        std::vector<FrameBuffer> frames;
+        std::vector<RenderContext> contexts;
+
+        std::vector<std::vector<shader::Vertex>> worldVertices;
+        std::vector<const std::vector<std::uint32_t>*> indices;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../core/Arena.hpp"
+#include "../core/Trace.hpp"
+#include "FrameBuffer.hpp"
+#include "PipelineState.hpp"
+#include "Rasterizer.hpp"
+#include "Shader.hpp"
+#include "TriangleSetup.hpp"
+
+namespace graphics {
+    constexpr inline int BIN_BAND_HEIGHT = 32;
+
+    // An indexed triangle draw split into the vertex, setup/bin and raster stages of a frame graph. Triangles are
+    // binned into horizontal bands in submission order, so bands rasterize concurrently and still match Render.
+    // Stage storage lives in the arenas passed in and must outlive the frame's raster tasks
+    template <PipelineState State = PipelineState{}, typename Shader = shader::Default>
+    class BinnedDraw {
+        static_assert(State.Blend != BlendMode::WeightedOIT, "Binned draws do not allocate transparency targets");
+
+    public:
+        BinnedDraw(const std::vector<shader::Vertex>& vertices, const std::vector<std::uint32_t>& indices,
+                   const std::uint32_t height, const int bandHeight = BIN_BAND_HEIGHT)
+            : vertices(vertices), indices(indices), bandHeight(bandHeight),
+              bandCount((static_cast<int>(height) + bandHeight - 1) / bandHeight) {}
+
+        inline void SetShader(const Shader& frameShader) { shader = frameShader; }
+
+        inline int GetBandCount() const noexcept { return bandCount; }
+
+        // Rows [band * bandHeight, (band + 1) * bandHeight) of rect
+        inline BoundingBox GetBand(const int band, const BoundingBox& rect) const noexcept {
+            const BoundingBox rows = {rect.MinX, rect.MaxX, band * bandHeight, (band + 1) * bandHeight - 1, true};
+            return Intersect(rows, rect);
+        }
+
+        inline void Transform(core::Arena& arena) {
+            TRACE_SCOPE("TransformVertices");
+
+            screenVertices = arena.Allocate<shader::Vertex>(vertices.size());
+            for(std::size_t i = 0; i < vertices.size(); ++i) {
+                screenVertices[i] = {shader.Vertex(vertices[i].Pos), vertices[i].Color};
+            }
+        }
+
+        // Sets up every triangle against clip, then lists each one in every band its bound reaches
+        inline void Bin(core::Arena& arena, const BoundingBox& clip) {
+            TRACE_SCOPE("SetupBin");
+
+            setups = arena.Allocate<TriangleSetup>(indices.size() / 3);
+            setupCount = SetupTriangles<State.Cull>(screenVertices, vertices.size(), indices.data(), indices.size() / 3,
+                                                    clip, setups);
+
+            binStarts = arena.Allocate<std::uint32_t>(static_cast<std::size_t>(bandCount) + 1);
+            std::fill_n(binStarts, bandCount + 1, 0u);
+
+            for(std::size_t i = 0; i < setupCount; ++i) {
+                for(int band = GetFirstBand(setups[i]); band <= GetLastBand(setups[i]); ++band) ++binStarts[band + 1];
+            }
+
+            for(int band = 0; band < bandCount; ++band) binStarts[band + 1] += binStarts[band];
+
+            binTriangles = arena.Allocate<std::uint32_t>(binStarts[bandCount]);
+            std::uint32_t* cursors = arena.Allocate<std::uint32_t>(static_cast<std::size_t>(bandCount));
+            std::copy_n(binStarts, bandCount, cursors);
+
+            for(std::size_t i = 0; i < setupCount; ++i) {
+                for(int band = GetFirstBand(setups[i]); band <= GetLastBand(setups[i]); ++band) {
+                    binTriangles[cursors[band]++] = static_cast<std::uint32_t>(i);
+                }
+            }
+        }
+
+        // Rasterizes the triangles of one band, restricted to the part of the band inside clip
+        inline void Rasterize(FrameBuffer& frame, const int band, const BoundingBox& clip) const {
+            TRACE_SCOPE("RasterBand");
+
+            const BoundingBox rect = GetBand(band, clip);
+            if(!rect.ShouldRender) return;
+
+            for(std::uint32_t i = binStarts[band]; i < binStarts[band + 1]; ++i) {
+                TriangleSetup setup = setups[binTriangles[i]];
+                setup.Bound = Intersect(setup.Bound, rect);
+
+                if(setup.Bound.ShouldRender) RasterizeTriangle<State>(frame, shader, setup);
+            }
+        }
+
+    private:
+        inline int GetFirstBand(const TriangleSetup& setup) const noexcept { return setup.Bound.MinY / bandHeight; }
+        inline int GetLastBand(const TriangleSetup& setup) const noexcept {
+            return std::min(bandCount - 1, setup.Bound.MaxY / bandHeight);
+        }
+
+        const std::vector<shader::Vertex>& vertices;
+        const std::vector<std::uint32_t>& indices;
+        Shader shader{};
+
+        shader::Vertex* screenVertices = nullptr;
+        TriangleSetup* setups = nullptr;
+        std::size_t setupCount = 0;
+        std::uint32_t* binStarts = nullptr;
+        std::uint32_t* binTriangles = nullptr;
+
+        int bandHeight;
+        int bandCount;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "../math/Math.hpp"
+#include "PipelineState.hpp"
+
+namespace graphics {
+    // Pixels are RGBA8 with red in the low byte. Every mode rounds c * f / 255 exactly, so the SIMD kernels and
+    // the scalar path produce identical pixels
+    constexpr inline bool IsPackedBlend(const BlendMode mode) noexcept {
+        return mode == BlendMode::Alpha || mode == BlendMode::Additive || mode == BlendMode::Premultiplied;
+    }
+
+    // Rounded division by 255 of the two 16-bit lanes of t, each at most 255 * 255
+    inline std::uint32_t Div255Pair(const std::uint32_t t) noexcept {
+        const std::uint32_t biased = t + 0x00800080u;
+        return ((biased + ((biased >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+    }
+
+    // Clamps the two 9-bit lanes of a sum to 255
+    inline std::uint32_t SaturatePair(const std::uint32_t sum) noexcept {
+        const std::uint32_t overflow = (sum >> 8) & 0x00010001u;
+        return (sum | overflow * 0xFFu) & 0x00FF00FFu;
+    }
+
+    // Two channels per multiply: red with blue, green with alpha
+    template <BlendMode Mode>
+    inline std::uint32_t BlendPixel(const std::uint32_t src, const std::uint32_t dst) noexcept {
+        static_assert(IsPackedBlend(Mode), "Not a packed blend mode");
+
+        const std::uint32_t alpha = src >> 24;
+        const std::uint32_t inv = 255 - alpha;
+        const std::uint32_t srcRB = src & 0x00FF00FFu;
+        const std::uint32_t srcGA = (src >> 8) & 0x00FF00FFu;
+        const std::uint32_t dstRB = dst & 0x00FF00FFu;
+        const std::uint32_t dstGA = (dst >> 8) & 0x00FF00FFu;
+
+        std::uint32_t rb;
+        std::uint32_t ga;
+
+        if constexpr(Mode == BlendMode::Alpha) {
+            rb = Div255Pair(srcRB * alpha + dstRB * inv);
+            ga = Div255Pair(srcGA * alpha + dstGA * inv);
+        } else if constexpr(Mode == BlendMode::Additive) {
+            rb = SaturatePair(Div255Pair(srcRB * alpha) + dstRB);
+            ga = SaturatePair(Div255Pair(srcGA * alpha) + dstGA);
+        } else {
+            rb = SaturatePair(srcRB + Div255Pair(dstRB * inv));
+            ga = SaturatePair(srcGA + Div255Pair(dstGA * inv));
+        }
+
+        return rb | ga << 8;
+    }
+
+    // Blends four pixels, keeping dst wherever bit i of mask is clear
+    template <BlendMode Mode>
+    inline void BlendQuad(std::uint32_t* dst, const std::uint32_t* src, const std::uint32_t mask) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+
+        __m128i alpha = _mm_srli_epi32(s, 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        const __m128i alphas[2] = {_mm_unpacklo_epi32(alpha, alpha), _mm_unpackhi_epi32(alpha, alpha)};
+
+        const __m128i sources[2] = {_mm_unpacklo_epi8(s, zero), _mm_unpackhi_epi8(s, zero)};
+        const __m128i dests[2] = {_mm_unpacklo_epi8(d, zero), _mm_unpackhi_epi8(d, zero)};
+        __m128i results[2];
+
+        auto Div255 = [&bias](const __m128i t) {
+            const __m128i biased = _mm_add_epi16(t, bias);
+            return _mm_srli_epi16(_mm_add_epi16(biased, _mm_srli_epi16(biased, 8)), 8);
+        };
+
+        for(int half = 0; half < 2; ++half) {
+            const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), alphas[half]);
+
+            if constexpr(Mode == BlendMode::Alpha) {
+                results[half] = Div255(_mm_add_epi16(_mm_mullo_epi16(sources[half], alphas[half]),
+                                                     _mm_mullo_epi16(dests[half], inv)));
+            } else if constexpr(Mode == BlendMode::Additive) {
+                results[half] = _mm_add_epi16(Div255(_mm_mullo_epi16(sources[half], alphas[half])), dests[half]);
+            } else {
+                results[half] = _mm_add_epi16(sources[half], Div255(_mm_mullo_epi16(dests[half], inv)));
+            }
+        }
+
+        const __m128i blended = _mm_packus_epi16(results[0], results[1]);
+
+        const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+        const __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(mask)), bits), bits);
+        const __m128i res = _mm_or_si128(_mm_and_si128(keep, blended), _mm_andnot_si128(keep, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), res);
+#elif defined(ENGINE_SIMD_NEON)
+        const uint8x16_t s = vld1q_u8(reinterpret_cast<const std::uint8_t*>(src));
+        const uint8x16_t d = vld1q_u8(reinterpret_cast<const std::uint8_t*>(dst));
+
+        const uint32x4_t alpha = vmulq_n_u32(vshrq_n_u32(vreinterpretq_u32_u8(s), 24), 0x01010101u);
+        const uint8x16_t alphas = vreinterpretq_u8_u32(alpha);
+        const uint8x16_t inv = vsubq_u8(vdupq_n_u8(255), alphas);
+
+        auto Div255 = [](const uint16x8_t t) { return vraddhn_u16(t, vrshrq_n_u16(t, 8)); };
+
+        uint8x16_t blended;
+        if constexpr(Mode == BlendMode::Alpha) {
+            const uint16x8_t low = vmlal_u8(vmull_u8(vget_low_u8(s), vget_low_u8(alphas)), vget_low_u8(d),
+                                            vget_low_u8(inv));
+            const uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(s), vget_high_u8(alphas)), vget_high_u8(d),
+                                             vget_high_u8(inv));
+            blended = vcombine_u8(Div255(low), Div255(high));
+        } else if constexpr(Mode == BlendMode::Additive) {
+            const uint8x8_t low = Div255(vmull_u8(vget_low_u8(s), vget_low_u8(alphas)));
+            const uint8x8_t high = Div255(vmull_u8(vget_high_u8(s), vget_high_u8(alphas)));
+            blended = vqaddq_u8(vcombine_u8(low, high), d);
+        } else {
+            const uint8x8_t low = Div255(vmull_u8(vget_low_u8(d), vget_low_u8(inv)));
+            const uint8x8_t high = Div255(vmull_u8(vget_high_u8(d), vget_high_u8(inv)));
+            blended = vqaddq_u8(s, vcombine_u8(low, high));
+        }
+
+        static const std::uint32_t bits[4] = {1, 2, 4, 8};
+        const uint32x4_t laneBits = vld1q_u32(bits);
+        const uint32x4_t keep = vceqq_u32(vandq_u32(vdupq_n_u32(mask), laneBits), laneBits);
+        vst1q_u8(reinterpret_cast<std::uint8_t*>(dst), vbslq_u8(vreinterpretq_u8_u32(keep), blended, d));
+#else
+        for(int i = 0; i < 4; ++i) {
+            if(mask >> i & 1u) dst[i] = BlendPixel<Mode>(src[i], dst[i]);
+        }
+#endif
+    }
+
+    // Blends src[i] over dst[i] where bit i of mask is set, four pixels per step; count is at most 32
+    template <BlendMode Mode>
+    inline void BlendPixels(std::uint32_t* dst, const std::uint32_t* src, const std::uint32_t count,
+                            const std::uint32_t mask = ~0u) noexcept {
+        std::uint32_t i = 0;
+
+        for(; i + 4 <= count; i += 4) {
+            const std::uint32_t quad = (mask >> i) & 0xFu;
+            if(quad != 0) BlendQuad<Mode>(dst + i, src + i, quad);
+        }
+
+        for(; i < count; ++i) {
+            if(mask >> i & 1u) dst[i] = BlendPixel<Mode>(src[i], dst[i]);
+        }
+    }
+
+    inline math::Vector UnpackColor(const std::uint32_t color) noexcept {
+        const math::Vector bytes(static_cast<float>(color & 0xFFu), static_cast<float>((color >> 8) & 0xFFu),
+                                 static_cast<float>((color >> 16) & 0xFFu), static_cast<float>(color >> 24));
+        return bytes * (1.f / 255.f);
+    }
+
+    inline std::uint32_t PackColor(const math::Vector& color) noexcept {
+        const math::Vector bytes(simd::Round(simd::Mul(color.V, simd::Set(255.f))));
+        auto Byte = [](const float v) { return static_cast<std::uint32_t>(v <= 0.f ? 0.f : v >= 255.f ? 255.f : v); };
+
+        return Byte(bytes.W) << 24 | Byte(bytes.Z) << 16 | Byte(bytes.Y) << 8 | Byte(bytes.X);
+    }
+
+    // Weighted-blended OIT weight (McGuire and Bavoil), favouring surfaces close to the camera
+    inline float GetTransparencyWeight(const float z, const float alpha) noexcept {
+        const float distance = 1.f - z;
+        return alpha * std::max(1e-2f, 3e3f * distance * distance * distance);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../core/Trace.hpp"
+#include "FrameBuffer.hpp"
+#include "PipelineState.hpp"
+
+namespace graphics {
+    // A render target with depth and no color, for shadow maps and other depth-only passes. Triangles drawn here
+    // run the depth-only raster kernel, which never interpolates color or calls the shader
+    class DepthBuffer {
+    public:
+        DepthBuffer(const std::uint32_t width, const std::uint32_t height)
+            : depthes(width * height, 1.f), width(width), height(height), scissor(GetFullRect(width, height)) {}
+
+        inline void Clear(const float clearDepth = 1.f) noexcept {
+            TRACE_SCOPE("ClearDepth");
+            std::fill(depthes.begin(), depthes.end(), clearDepth);
+        }
+
+        inline void Clear(const BoundingBox& rect, const float clearDepth = 1.f) noexcept {
+            const BoundingBox clipped = Intersect(rect, GetFullRect(width, height));
+            if(!clipped.ShouldRender) return;
+
+            const std::size_t count = static_cast<std::size_t>(clipped.MaxX - clipped.MinX + 1);
+            for(int y = clipped.MinY; y <= clipped.MaxY; ++y) {
+                std::fill_n(depthes.begin() + static_cast<std::size_t>(y) * width + clipped.MinX, count, clearDepth);
+            }
+        }
+
+        inline void SetScissor(const BoundingBox& rect) noexcept {
+            scissor = Intersect(rect, GetFullRect(width, height));
+        }
+
+        inline void ResetScissor() noexcept { scissor = GetFullRect(width, height); }
+        inline const BoundingBox& GetScissor() const noexcept { return scissor; }
+
+        template <DepthFunc Func, bool Write>
+        inline bool TestDepth(const std::uint32_t x, const std::uint32_t y, const float z) noexcept {
+            if constexpr(Func == DepthFunc::Always && !Write) return true;
+            else {
+                float& depth = depthes[y * width + x];
+                const bool passed = CompareDepth<Func>(z, depth);
+
+                if constexpr(Write) depth = passed ? z : depth;
+                return passed;
+            }
+        }
+
+        inline float GetDepth(const std::uint32_t x, const std::uint32_t y) const noexcept {
+            return depthes[y * width + x];
+        }
+
+        inline float* GetDepth() noexcept { return depthes.data(); }
+        inline const float* GetDepth() const noexcept { return depthes.data(); }
+
+        inline std::uint32_t GetWidth() const noexcept { return width; }
+        inline std::uint32_t GetHeight() const noexcept { return height; }
+
+    private:
+        std::vector<float> depthes;
+        std::uint32_t width;
+        std::uint32_t height;
+        BoundingBox scissor;
+    };
+}
\ No newline at end of file
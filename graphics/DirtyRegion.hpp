@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../core/Trace.hpp"
+#include "FrameBuffer.hpp"
+#include "Shader.hpp"
+
+namespace graphics {
+    constexpr inline std::size_t MAX_DIRTY_RECTS = 8;
+
+    // Pixels a draw of these vertices can touch, clamped to the target; padding covers point sizes and rounding
+    template <typename Shader>
+    inline BoundingBox GetScreenBound(const Shader& shader, const std::vector<shader::Vertex>& vertices,
+                                      const std::uint32_t width, const std::uint32_t height, const int padding = 1) {
+        const float limit = static_cast<float>(width + height);
+        BoundingBox bound = {0, -1, 0, -1, false};
+
+        for(const shader::Vertex& vertex : vertices) {
+            const math::Vector pos = shader.Vertex(vertex.Pos);
+            if(!std::isfinite(pos.X) || !std::isfinite(pos.Y)) return GetFullRect(width, height);
+
+            const int x = static_cast<int>(std::clamp(pos.X, -limit, limit));
+            const int y = static_cast<int>(std::clamp(pos.Y, -limit, limit));
+            bound = Unite(bound, {x - padding, x + padding, y - padding, y + padding, true});
+        }
+
+        return Intersect(bound, GetFullRect(width, height));
+    }
+
+    // Screen areas changed since the last frame. Overlapping rectangles are merged, and past MAX_DIRTY_RECTS the pair
+    // whose union adds the least area is merged, so the number of scissored passes stays bounded
+    class DirtyRegion {
+    public:
+        DirtyRegion(const std::uint32_t width, const std::uint32_t height) : width(width), height(height) {}
+
+        inline void Add(const BoundingBox& rect) {
+            BoundingBox merged = Intersect(rect, GetFullRect(width, height));
+            if(!merged.ShouldRender) return;
+
+            for(std::size_t i = 0; i < rects.size();) {
+                if(Intersect(rects[i], merged).ShouldRender) {
+                    merged = Unite(merged, rects[i]);
+                    rects[i] = rects.back();
+                    rects.pop_back();
+                    i = 0;
+                } else {
+                    ++i;
+                }
+            }
+
+            rects.push_back(merged);
+            if(rects.size() > MAX_DIRTY_RECTS) MergeCheapest();
+        }
+
+        // An object moved or changed: both where it was and where it is now need redrawing
+        inline void Add(const BoundingBox& previous, const BoundingBox& current) {
+            Add(previous);
+            Add(current);
+        }
+
+        inline void AddAll() { rects.assign(1, GetFullRect(width, height)); }
+
+        inline void Reset() noexcept { rects.clear(); }
+
+        inline bool IsEmpty() const noexcept { return rects.empty(); }
+        inline const std::vector<BoundingBox>& GetRects() const noexcept { return rects; }
+
+        inline std::size_t GetArea() const noexcept {
+            std::size_t area = 0;
+            for(const BoundingBox& rect : rects) area += GetArea(rect);
+            return area;
+        }
+
+    private:
+        static inline std::size_t GetArea(const BoundingBox& rect) noexcept {
+            const std::size_t columns = static_cast<std::size_t>(rect.MaxX - rect.MinX + 1);
+            return columns * static_cast<std::size_t>(rect.MaxY - rect.MinY + 1);
+        }
+
+        inline void MergeCheapest() {
+            std::size_t bestA = 0;
+            std::size_t bestB = 1;
+            std::size_t bestCost = SIZE_MAX;
+
+            for(std::size_t a = 0; a < rects.size(); ++a) {
+                for(std::size_t b = a + 1; b < rects.size(); ++b) {
+                    const std::size_t cost = GetArea(Unite(rects[a], rects[b])) - GetArea(rects[a]) - GetArea(rects[b]);
+                    if(cost < bestCost) {
+                        bestCost = cost;
+                        bestA = a;
+                        bestB = b;
+                    }
+                }
+            }
+
+            const BoundingBox merged = Unite(rects[bestA], rects[bestB]);
+            rects[bestB] = rects.back();
+            rects.pop_back();
+            rects[bestA] = rects.back();
+            rects.pop_back();
+
+            Add(merged);
+        }
+
+        std::vector<BoundingBox> rects;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    // Clears and redraws each dirty rectangle under a scissor, keeping the previous frame's color and depth
+    // everywhere else; draw(frame) issues the scene's Render calls. The region is reset afterwards
+    template <typename Draw>
+    inline void RenderDirty(FrameBuffer& frame, DirtyRegion& region, const std::uint32_t clearColor, Draw&& draw) {
+        TRACE_SCOPE("RenderDirty");
+
+        for(const BoundingBox& rect : region.GetRects()) {
+            frame.SetScissor(rect);
+            frame.Clear(rect, clearColor);
+            draw(frame);
+        }
+
+        frame.ResetScissor();
+        region.Reset();
+    }
+}
\ No newline at end of file
@@ -3,7 +3,10 @@
 #include <algorithm>
 #include <vector>
 
+#include "../core/Trace.hpp"
 #include "../math/Math.hpp"
+#include "Blend.hpp"
+#include "PipelineState.hpp"
 
 namespace graphics {
     struct BoundingBox {
@@ -14,25 +17,75 @@ namespace graphics {
         bool ShouldRender;
     };
 
+    inline BoundingBox GetBound(const math::Vector& v0, const math::Vector& v1, const math::Vector& v2,
+                                const std::uint32_t width, const std::uint32_t height) {
+        if(v0.Z < 0.f || v1.Z < 0.f || v2.Z < 0.f) return {0, 0, 0, 0, false};
+
+        int minX = std::max({0, static_cast<int>(std::floor(std::min({v0.X, v1.X, v2.X})))});
+        int maxX = std::min({static_cast<int>(width - 1), static_cast<int>(std::ceil(std::max({v0.X, v1.X, v2.X})))});
+        int minY = std::max({0, static_cast<int>(std::floor(std::min({v0.Y, v1.Y, v2.Y})))});
+        int maxY =
+            std::min({static_cast<int>(height - 1), static_cast<int>(std::ceil(std::max({v0.Y, v1.Y, v2.Y})))});
+
+        return {minX, maxX, minY, maxY, minX <= maxX && minY <= maxY};
+    }
+
+    // Every pixel of a width x height target; rectangles are inclusive on both ends
+    inline BoundingBox GetFullRect(const std::uint32_t width, const std::uint32_t height) noexcept {
+        return {0, static_cast<int>(width) - 1, 0, static_cast<int>(height) - 1, width > 0 && height > 0};
+    }
+
+    inline BoundingBox Intersect(const BoundingBox& a, const BoundingBox& b) noexcept {
+        const int minX = std::max(a.MinX, b.MinX);
+        const int maxX = std::min(a.MaxX, b.MaxX);
+        const int minY = std::max(a.MinY, b.MinY);
+        const int maxY = std::min(a.MaxY, b.MaxY);
+
+        return {minX, maxX, minY, maxY, a.ShouldRender && b.ShouldRender && minX <= maxX && minY <= maxY};
+    }
+
+    // Smallest rectangle holding both; an empty rectangle contributes nothing
+    inline BoundingBox Unite(const BoundingBox& a, const BoundingBox& b) noexcept {
+        if(!a.ShouldRender) return b;
+        if(!b.ShouldRender) return a;
+
+        return {std::min(a.MinX, b.MinX), std::max(a.MaxX, b.MaxX), std::min(a.MinY, b.MinY), std::max(a.MaxY, b.MaxY),
+                true};
+    }
+
+    inline bool Contains(const BoundingBox& rect, const int x, const int y) noexcept {
+        return x >= rect.MinX && x <= rect.MaxX && y >= rect.MinY && y <= rect.MaxY;
+    }
+
     class FrameBuffer {
     public:
         FrameBuffer(const std::uint32_t width, const std::uint32_t height)
-            : colors(width * height, 0), depthes(width * height, 1.0f), width(width), height(height) {}
+            : colors(width * height, 0), depthes(width * height, 1.0f), width(width), height(height),
+              imageHeight(height), scissor(GetFullRect(width, height)) {}
 
         ~FrameBuffer() = default;
 
         FrameBuffer(const FrameBuffer& other) noexcept
-            : colors(other.colors), depthes(other.depthes), width(other.width), height(other.height) {}
+            : colors(other.colors), depthes(other.depthes), accumulation(other.accumulation),
+              revealage(other.revealage), width(other.width), height(other.height), originY(other.originY),
+              imageHeight(other.imageHeight), scissor(other.scissor) {}
 
         FrameBuffer(FrameBuffer&& other) noexcept
-            : colors(other.colors), depthes(other.depthes), width(other.width), height(other.height) {}
+            : colors(other.colors), depthes(other.depthes), accumulation(other.accumulation),
+              revealage(other.revealage), width(other.width), height(other.height), originY(other.originY),
+              imageHeight(other.imageHeight), scissor(other.scissor) {}
 
         FrameBuffer& operator=(const FrameBuffer& other) noexcept {
             if(this != &other) {
                 colors = other.colors;
                 depthes = other.depthes;
+                accumulation = other.accumulation;
+                revealage = other.revealage;
                 width = other.width;
                 height = other.height;
+                originY = other.originY;
+                imageHeight = other.imageHeight;
+                scissor = other.scissor;
             }
             return *this;
         }
@@ -41,51 +94,179 @@ namespace graphics {
             if(this != &other) {
                 colors = other.colors;
                 depthes = other.depthes;
+                accumulation = other.accumulation;
+                revealage = other.revealage;
                 width = other.width;
                 height = other.height;
+                originY = other.originY;
+                imageHeight = other.imageHeight;
+                scissor = other.scissor;
             }
             return *this;
         }
 
         inline void Clear(const std::uint32_t clearColor = 0) noexcept {
+            TRACE_SCOPE("Clear");
+
             std::fill(colors.begin(), colors.end(), clearColor);
             std::fill(depthes.begin(), depthes.end(), 1.f);
+            std::fill(accumulation.begin(), accumulation.end(), math::Vector());
+            std::fill(revealage.begin(), revealage.end(), 1.f);
+        }
+
+        // Clears only the pixels inside rect, leaving the rest of the previous frame in place
+        inline void Clear(const BoundingBox& rect, const std::uint32_t clearColor = 0) noexcept {
+            TRACE_SCOPE("ClearRect");
+
+            const BoundingBox clipped = Intersect(rect, GetRect());
+            if(!clipped.ShouldRender) return;
+
+            const std::size_t count = static_cast<std::size_t>(clipped.MaxX - clipped.MinX + 1);
+
+            for(int y = clipped.MinY; y <= clipped.MaxY; ++y) {
+                const std::size_t row =
+                    GetIndex(static_cast<std::uint32_t>(clipped.MinX), static_cast<std::uint32_t>(y));
+
+                std::fill_n(colors.begin() + row, count, clearColor);
+                std::fill_n(depthes.begin() + row, count, 1.f);
+
+                if(!accumulation.empty()) {
+                    std::fill_n(accumulation.begin() + row, count, math::Vector());
+                    std::fill_n(revealage.begin() + row, count, 1.f);
+                }
+            }
+        }
+
+        // Restricts every later draw to rect until the scissor is reset
+        inline void SetScissor(const BoundingBox& rect) noexcept {
+            scissor = Intersect(rect, GetRect());
+        }
+
+        inline void ResetScissor() noexcept { scissor = GetRect(); }
+        inline const BoundingBox& GetScissor() const noexcept { return scissor; }
+
+        // Moves the buffer over rows [bandOriginY, bandOriginY + height) of an image bandImageHeight rows tall. Draws
+        // keep using image coordinates and are scissored to the band, so its pixels match a full-frame render
+        inline void SetBand(const std::uint32_t bandOriginY, const std::uint32_t bandImageHeight) noexcept {
+            originY = bandOriginY;
+            imageHeight = bandImageHeight;
+            ResetScissor();
+        }
+
+        // The image pixels this buffer holds, in image coordinates; the last band of an image may not fill it
+        inline BoundingBox GetRect() const noexcept {
+            const int maxY = static_cast<int>(std::min(originY + height, imageHeight)) - 1;
+            return {0, static_cast<int>(width) - 1, static_cast<int>(originY), maxY,
+                    width > 0 && maxY >= static_cast<int>(originY)};
         }
 
         inline void SetPixel(const std::uint32_t x, const std::uint32_t y, const std::uint32_t color) noexcept {
-            colors[y * width + x] = color;
+            colors[GetIndex(x, y)] = color;
         }
 
         inline bool IsVisible(const std::uint32_t x, const std::uint32_t y, const float z) {
-            const std::uint32_t index = y * width + x;
+            return TestDepth<DepthFunc::Less, true>(x, y, z);
+        }
+
+        // Func and Write are fixed per pipeline state; Always without Write never touches the depth buffer
+        template <DepthFunc Func, bool Write>
+        inline bool TestDepth(const std::uint32_t x, const std::uint32_t y, const float z) noexcept {
+            if constexpr(Func == DepthFunc::Always && !Write) return true;
+            else {
+                float& depth = depthes[GetIndex(x, y)];
+                const bool passed = CompareDepth<Func>(z, depth);
+
+                if constexpr(Write) depth = passed ? z : depth;
+                return passed;
+            }
+        }
 
-            if(z < depthes[index]) {
-                depthes[index] = z;
-                return true;
+        // Depth test, depth write, color write and blending for one fragment, all fixed by State; shade() only runs
+        // for fragments that will be written
+        template <PipelineState State, typename Shade>
+        inline void WriteFragment(const std::uint32_t x, const std::uint32_t y, const float z, Shade&& shade) {
+            if(!TestDepth<State.Depth, State.DepthWrite>(x, y, z)) return;
+
+            if constexpr(!State.ColorWrite) return;
+            else if constexpr(State.Blend == BlendMode::Opaque) SetPixel(x, y, shade());
+            else if constexpr(State.Blend == BlendMode::WeightedOIT) AccumulateTransparent(x, y, z, shade());
+            else {
+                std::uint32_t& pixel = colors[GetIndex(x, y)];
+                pixel = graphics::BlendPixel<State.Blend>(shade(), pixel);
             }
+        }
 
-            return false;
+        // Blends up to 32 packed colors into row y starting at x, skipping pixels whose mask bit is clear
+        template <BlendMode Mode>
+        inline void BlendRow(const std::uint32_t x, const std::uint32_t y, const std::uint32_t* src,
+                             const std::uint32_t count, const std::uint32_t mask) noexcept {
+            BlendPixels<Mode>(colors.data() + GetIndex(x, y), src, count, mask);
         }
 
-        inline BoundingBox GetBound(const math::Vector& v0, const math::Vector& v1, const math::Vector& v2) {
-            if(v0.Z < 0.f || v1.Z < 0.f || v2.Z < 0.f) return {0, 0, 0, 0, false};
+        // Allocates the accumulation and revealage targets of weighted-blended transparency on first use
+        inline void EnableTransparency() {
+            if(!accumulation.empty()) return;
 
-            int minX = std::max({0, static_cast<int>(std::floor(std::min({v0.X, v1.X, v2.X})))});
-            int maxX =
-                std::min({static_cast<int>(width - 1), static_cast<int>(std::ceil(std::max({v0.X, v1.X, v2.X})))});
-            int minY = std::max({0, static_cast<int>(std::floor(std::min({v0.Y, v1.Y, v2.Y})))});
-            int maxY =
-                std::min({static_cast<int>(height - 1), static_cast<int>(std::ceil(std::max({v0.Y, v1.Y, v2.Y})))});
+            accumulation.assign(colors.size(), math::Vector());
+            revealage.assign(colors.size(), 1.f);
+        }
+
+        inline void AccumulateTransparent(const std::uint32_t x, const std::uint32_t y, const float z,
+                                          const std::uint32_t color) noexcept {
+            const std::uint32_t index = GetIndex(x, y);
+            const math::Vector straight = UnpackColor(color);
+            const float alpha = straight.W;
+            const float weight = GetTransparencyWeight(z, alpha);
 
-            return {minX, maxX, minY, maxY, minX <= maxX && minY <= maxY};
+            const math::Vector premultiplied(straight.X * alpha, straight.Y * alpha, straight.Z * alpha, alpha);
+            accumulation[index] += premultiplied * weight;
+            revealage[index] *= 1.f - alpha;
+        }
+
+        // Composites the weighted average of the transparent fragments over the opaque colors and resets the targets
+        inline void ResolveTransparency() noexcept {
+            for(std::size_t i = 0; i < accumulation.size(); ++i) {
+                const float reveal = revealage[i];
+                if(reveal >= 1.f) continue;
+
+                const math::Vector& sum = accumulation[i];
+                const math::Vector average = sum * ((1.f - reveal) / std::max(sum.W, 1e-5f));
+                const math::Vector background = UnpackColor(colors[i]);
+
+                math::Vector composited = average + background * reveal;
+                composited.W = background.W;
+                colors[i] = PackColor(composited);
+
+                accumulation[i] = math::Vector();
+                revealage[i] = 1.f;
+            }
+        }
+
+        inline BoundingBox GetBound(const math::Vector& v0, const math::Vector& v1, const math::Vector& v2) {
+            return graphics::GetBound(v0, v1, v2, width, imageHeight);
         }
 
         inline std::uint32_t* GetColor() { return colors.data(); }
+        inline const std::uint32_t* GetColor() const noexcept { return colors.data(); }
+
+        inline std::uint32_t GetWidth() const noexcept { return width; }
+        inline std::uint32_t GetHeight() const noexcept { return height; }
+        inline std::uint32_t GetOriginY() const noexcept { return originY; }
+        inline std::uint32_t GetImageHeight() const noexcept { return imageHeight; }
 
     private:
+        inline std::uint32_t GetIndex(const std::uint32_t x, const std::uint32_t y) const noexcept {
+            return (y - originY) * width + x;
+        }
+
         std::vector<std::uint32_t> colors;
         std::vector<float> depthes;
+        std::vector<math::Vector> accumulation;
+        std::vector<float> revealage;
         std::uint32_t width;
         std::uint32_t height;
+        std::uint32_t originY = 0;
+        std::uint32_t imageHeight;
+        BoundingBox scissor;
     };
 }
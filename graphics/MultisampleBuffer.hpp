@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../math/Math.hpp"
+#include "FrameBuffer.hpp"
+
+namespace graphics {
+    enum class SampleCount : std::uint32_t { X4 = 4, X8 = 8 };
+
+    // Standard sample positions, offsets from the pixel center in 1/16 pixel units
+    constexpr inline std::int8_t SAMPLE_PATTERN_4[4][2] = {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}};
+    constexpr inline std::int8_t SAMPLE_PATTERN_8[8][2] = {{1, -3},  {-1, 3}, {5, 1},  {-3, -5},
+                                                          {-5, 5}, {-7, -1}, {3, 7}, {7, -7}};
+
+    // Pixels keep one color while every sample agrees and only get per-sample storage once an edge splits them
+    class MultisampleBuffer {
+    public:
+        MultisampleBuffer(const std::uint32_t width, const std::uint32_t height,
+                          const SampleCount count = SampleCount::X4)
+            : colors(width * height, 0), blocks(width * height, COMPRESSED | NO_BLOCK),
+              depthes(width * height * static_cast<std::uint32_t>(count), 1.f), resolved(width * height, 0),
+              width(width), height(height), samples(static_cast<std::uint32_t>(count)),
+              scissor(GetFullRect(width, height)) {}
+
+        ~MultisampleBuffer() = default;
+
+        inline void Clear(const std::uint32_t clearColor = 0) noexcept {
+            std::fill(colors.begin(), colors.end(), clearColor);
+            std::fill(blocks.begin(), blocks.end(), COMPRESSED | NO_BLOCK);
+            std::fill(depthes.begin(), depthes.end(), 1.f);
+            sampleColors.clear();
+        }
+
+        // Depth-tests the covered samples and returns the ones that passed
+        template <DepthFunc Func = DepthFunc::Less, bool Write = true>
+        inline std::uint32_t TestDepth(const std::uint32_t x, const std::uint32_t y, const float* z,
+                                       const std::uint32_t coverage) noexcept {
+            float* depth = depthes.data() + (y * width + x) * samples;
+            std::uint32_t passed = 0;
+
+            for(std::uint32_t s = 0; s < samples; ++s) {
+                const bool visible = (coverage >> s & 1u) && CompareDepth<Func>(z[s], depth[s]);
+
+                if constexpr(Write) depth[s] = visible ? z[s] : depth[s];
+                passed |= static_cast<std::uint32_t>(visible) << s;
+            }
+
+            return passed;
+        }
+
+        inline void SetSamples(const std::uint32_t x, const std::uint32_t y, const std::uint32_t mask,
+                               const std::uint32_t color) {
+            const std::uint32_t index = y * width + x;
+
+            if(mask == GetFullMask()) {
+                colors[index] = color;
+                blocks[index] |= COMPRESSED;
+                return;
+            }
+
+            if(blocks[index] & COMPRESSED) {
+                std::uint32_t block = blocks[index] & ~COMPRESSED;
+
+                if(block == NO_BLOCK) {
+                    block = static_cast<std::uint32_t>(sampleColors.size());
+                    sampleColors.resize(sampleColors.size() + samples);
+                }
+
+                std::fill_n(sampleColors.begin() + block, samples, colors[index]);
+                blocks[index] = block;
+            }
+
+            std::uint32_t* sample = sampleColors.data() + blocks[index];
+            for(std::uint32_t s = 0; s < samples; ++s) {
+                if(mask >> s & 1u) sample[s] = color;
+            }
+        }
+
+        // Averages split pixels two channels at a time; agreeing pixels are copied through
+        inline void Resolve() noexcept {
+            const std::uint32_t shift = samples == 8 ? 3 : 2;
+            const std::uint32_t half = (samples >> 1) * 0x00010001u;
+
+            for(std::size_t i = 0; i < colors.size(); ++i) {
+                if(blocks[i] & COMPRESSED) {
+                    resolved[i] = colors[i];
+                    continue;
+                }
+
+                const std::uint32_t* sample = sampleColors.data() + blocks[i];
+                std::uint32_t rb = half;
+                std::uint32_t ga = half;
+
+                for(std::uint32_t s = 0; s < samples; ++s) {
+                    rb += sample[s] & 0x00FF00FFu;
+                    ga += (sample[s] >> 8) & 0x00FF00FFu;
+                }
+
+                resolved[i] = ((rb >> shift) & 0x00FF00FFu) | (((ga >> shift) & 0x00FF00FFu) << 8);
+            }
+        }
+
+        // Restricts every later draw to the pixels of rect, all of their samples included, until the scissor is reset
+        inline void SetScissor(const BoundingBox& rect) noexcept {
+            scissor = Intersect(rect, GetFullRect(width, height));
+        }
+
+        inline void ResetScissor() noexcept { scissor = GetFullRect(width, height); }
+        inline const BoundingBox& GetScissor() const noexcept { return scissor; }
+
+        inline BoundingBox GetBound(const math::Vector& v0, const math::Vector& v1, const math::Vector& v2) {
+            return graphics::GetBound(v0, v1, v2, width, height);
+        }
+
+        inline const std::int8_t (*GetPattern() const noexcept)[2] {
+            return samples == 8 ? SAMPLE_PATTERN_8 : SAMPLE_PATTERN_4;
+        }
+
+        inline std::uint32_t GetFullMask() const noexcept { return (1u << samples) - 1; }
+
+        inline std::uint32_t* GetColor() { return resolved.data(); }
+
+        inline std::uint32_t GetWidth() const noexcept { return width; }
+        inline std::uint32_t GetHeight() const noexcept { return height; }
+        inline std::uint32_t GetSampleCount() const noexcept { return samples; }
+
+    private:
+        static constexpr std::uint32_t COMPRESSED = 0x80000000u;
+        static constexpr std::uint32_t NO_BLOCK = 0x7FFFFFFFu;
+
+        std::vector<std::uint32_t> colors;
+        std::vector<std::uint32_t> blocks;
+        std::vector<std::uint32_t> sampleColors;
+        std::vector<float> depthes;
+        std::vector<std::uint32_t> resolved;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t samples;
+        BoundingBox scissor;
+    };
+}
\ No newline at end of file
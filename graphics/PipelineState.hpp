@@ -0,0 +1,38 @@
+﻿#pragma once
+
+namespace graphics {
+    // Winding is judged after the viewport transform; Back drops what the default pipeline has always dropped
+    enum class CullMode { None, Back, Front };
+
+    enum class DepthFunc { Never, Less, Equal, LessEqual, Greater, NotEqual, GreaterEqual, Always };
+
+    // Packed modes blend into the RGBA8 color target; WeightedOIT accumulates into the transparency targets and is
+    // composited by FrameBuffer::ResolveTransparency once every transparent draw is done
+    enum class BlendMode { Opaque, Alpha, Additive, Premultiplied, WeightedOIT };
+
+    // Fixed-function state passed as a template argument, so every combination gets its own raster loop with the
+    // state folded away instead of branched on per pixel
+    struct PipelineState {
+        CullMode Cull = CullMode::Back;
+        DepthFunc Depth = DepthFunc::Less;
+        bool DepthWrite = true;
+        bool ColorWrite = true;
+        BlendMode Blend = BlendMode::Opaque;
+    };
+
+    // Z-prepass: the first pass lays down depth only, then the color pass shades exactly the surviving fragment of
+    // each pixel. Both passes must use the same cull mode and shader positions
+    constexpr inline PipelineState DEPTH_PREPASS = {.ColorWrite = false};
+    constexpr inline PipelineState DEPTH_EQUAL_COLOR = {.Depth = DepthFunc::Equal, .DepthWrite = false};
+
+    template <DepthFunc Func> inline bool CompareDepth(const float z, const float stored) noexcept {
+        if constexpr(Func == DepthFunc::Never) return false;
+        else if constexpr(Func == DepthFunc::Less) return z < stored;
+        else if constexpr(Func == DepthFunc::Equal) return z == stored;
+        else if constexpr(Func == DepthFunc::LessEqual) return z <= stored;
+        else if constexpr(Func == DepthFunc::Greater) return z > stored;
+        else if constexpr(Func == DepthFunc::NotEqual) return z != stored;
+        else if constexpr(Func == DepthFunc::GreaterEqual) return z >= stored;
+        else return true;
+    }
+}
\ No newline at end of file
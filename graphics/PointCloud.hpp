@@ -0,0 +1,309 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../core/Arena.hpp"
+#include "../core/JobSystem.hpp"
+#include "../core/Trace.hpp"
+#include "../math/Math.hpp"
+#include "FrameBuffer.hpp"
+#include "PipelineState.hpp"
+#include "RenderContext.hpp"
+#include "Shader.hpp"
+
+namespace graphics {
+    constexpr inline int POINT_TILE_SIZE = 64;
+    constexpr inline std::size_t POINT_CHUNK_SIZE = 16384;
+
+    struct PointSize {
+        float Size = 1.f;
+        bool Attenuate = false;
+        float MinSize = 1.f;
+        float MaxSize = 64.f;
+    };
+
+    struct ScreenPoint {
+        int X;
+        int Y;
+        int Size;
+        float Z;
+        std::uint32_t Color;
+    };
+
+    // Shaders whose vertex transform is a plain MVP followed by a viewport; their points transform four at a time
+    template <typename Shader>
+    concept MatrixShader = requires(const Shader& shader) {
+        shader.MVP;
+        shader.Viewport;
+    };
+
+    // Projects count points and writes the ones that land inside the viewport to out, which has room for count
+    // points; returns how many were kept. Point k is points[indices[k]], or points[k] without indices, and indices
+    // past pointCount are skipped. MatrixShader shaders run four points per iteration in SoA form, any other shader
+    // goes through its own Vertex() one point at a time with the same clipping, rounding and sizing
+    template <typename Shader>
+    inline std::size_t TransformPoints(const Shader& shader, const shader::Vertex* points, const std::size_t pointCount,
+                                       const std::uint32_t* indices, const std::size_t count, const PointSize& size,
+                                       const int width, const int height, ScreenPoint* out) {
+        std::size_t kept = 0;
+
+        auto Emit = [&](const float x, const float y, const float z, const float w, const std::size_t index) {
+            const float pixels = size.Attenuate ? std::clamp(size.Size / w, size.MinSize, size.MaxSize) : size.Size;
+            const int extent = std::max(1, static_cast<int>(pixels + 0.5f));
+
+            const int left = static_cast<int>(x) - (extent - 1) / 2;
+            const int top = static_cast<int>(y) - (extent - 1) / 2;
+
+            if(left + extent <= 0 || top + extent <= 0 || left >= width || top >= height) return;
+
+            out[kept++] = {left, top, extent, z, shader.Color(points[index].Color)};
+        };
+
+        const float margin = size.Attenuate ? size.MaxSize : size.Size;
+
+        if constexpr(!MatrixShader<Shader>) {
+            assert(!size.Attenuate && "Attenuated point sizes need the clip-space w of a MatrixShader");
+
+            for(std::size_t i = 0; i < count; ++i) {
+                const std::size_t index = indices ? indices[i] : i;
+                if(index >= pointCount) continue;
+
+                const math::Vector pos = shader.Vertex(points[index].Pos);
+                if(!(pos.Z >= 0.f && pos.Z <= 1.f && pos.X > -margin && pos.X < static_cast<float>(width) + margin &&
+                     pos.Y > -margin && pos.Y < static_cast<float>(height) + margin))
+                    continue;
+
+                Emit(std::round(pos.X), std::round(pos.Y), pos.Z, 1.f, index);
+            }
+
+            return kept;
+        } else {
+            simd::Floats mvp[4][4];
+            simd::Floats viewport[4][4];
+
+            for(int col = 0; col < 4; ++col) {
+                for(int row = 0; row < 4; ++row) {
+                    mvp[col][row] = simd::Set(shader.MVP[col][row]);
+                    viewport[col][row] = simd::Set(shader.Viewport[col][row]);
+                }
+            }
+
+            const simd::Floats one = simd::Set(1.f);
+            const simd::Floats zero = simd::Reset();
+            const simd::Floats minW = simd::Set(1e-6f);
+            const simd::Floats minXY = simd::Set(-margin);
+            const simd::Floats maxX = simd::Set(static_cast<float>(width) + margin);
+            const simd::Floats maxY = simd::Set(static_cast<float>(height) + margin);
+
+            for(std::size_t i = 0; i < count; i += 4) {
+                const std::size_t lanes = std::min<std::size_t>(4, count - i);
+
+                std::size_t index[4];
+                int valid = 0;
+                simd::Floats p[4];
+
+                for(std::size_t lane = 0; lane < 4; ++lane) {
+                    index[lane] = lane < lanes ? (indices ? indices[i + lane] : i + lane) : pointCount;
+                    const bool fetched = index[lane] < pointCount;
+
+                    valid |= static_cast<int>(fetched) << lane;
+                    p[lane] = fetched ? points[index[lane]].Pos.V : simd::Reset();
+                }
+
+                const simd::Floats t0 = simd::UnpackLow(p[0], p[1]);
+                const simd::Floats t1 = simd::UnpackHigh(p[0], p[1]);
+                const simd::Floats t2 = simd::UnpackLow(p[2], p[3]);
+                const simd::Floats t3 = simd::UnpackHigh(p[2], p[3]);
+
+                const simd::Floats in[4] = {simd::PackLowHigh(t0, t2), simd::PackHighLow(t2, t0),
+                                            simd::PackLowHigh(t1, t3), simd::PackHighLow(t3, t1)};
+
+                simd::Floats clip[4];
+                for(int row = 0; row < 4; ++row) {
+                    simd::Floats res = simd::Mul(mvp[0][row], in[0]);
+                    res = simd::Add(res, simd::Mul(mvp[1][row], in[1]));
+                    res = simd::Add(res, simd::Mul(mvp[2][row], in[2]));
+                    res = simd::Add(res, simd::Mul(mvp[3][row], in[3]));
+                    clip[row] = res;
+                }
+
+                const simd::Floats invW = simd::Div(one, clip[3]);
+                const simd::Floats ndc[3] = {simd::Mul(clip[0], invW), simd::Mul(clip[1], invW),
+                                             simd::Mul(clip[2], invW)};
+
+                simd::Floats screen[3];
+                for(int row = 0; row < 3; ++row) {
+                    simd::Floats res = simd::Mul(viewport[0][row], ndc[0]);
+                    res = simd::Add(res, simd::Mul(viewport[1][row], ndc[1]));
+                    res = simd::Add(res, simd::Mul(viewport[2][row], ndc[2]));
+                    res = simd::Add(res, viewport[3][row]);
+                    screen[row] = res;
+                }
+
+                simd::Floats inside = simd::And(simd::Less(minW, clip[3]), simd::LessEqual(zero, screen[2]));
+                inside = simd::And(inside, simd::LessEqual(screen[2], one));
+                inside = simd::And(inside, simd::And(simd::Less(minXY, screen[0]), simd::Less(screen[0], maxX)));
+                inside = simd::And(inside, simd::And(simd::Less(minXY, screen[1]), simd::Less(screen[1], maxY)));
+
+                int mask = simd::GetMask(inside) & valid;
+                if(mask == 0) continue;
+
+                const simd::Floats roundedX = simd::Round(screen[0]);
+                const simd::Floats roundedY = simd::Round(screen[1]);
+
+                const float* xs = reinterpret_cast<const float*>(&roundedX);
+                const float* ys = reinterpret_cast<const float*>(&roundedY);
+                const float* zs = reinterpret_cast<const float*>(&screen[2]);
+                const float* ws = reinterpret_cast<const float*>(&clip[3]);
+
+                for(; mask != 0; mask &= mask - 1) {
+                    const int lane = std::countr_zero(static_cast<unsigned>(mask));
+                    Emit(xs[lane], ys[lane], zs[lane], ws[lane], index[lane]);
+                }
+            }
+
+            return kept;
+        }
+    }
+
+    template <PipelineState State = PipelineState{}>
+    inline void SplatPoint(FrameBuffer& frame, const ScreenPoint& point, const int minX, const int minY,
+                           const int maxX, const int maxY) {
+        const int x0 = std::max(minX, point.X);
+        const int y0 = std::max(minY, point.Y);
+        const int x1 = std::min(maxX, point.X + point.Size);
+        const int y1 = std::min(maxY, point.Y + point.Size);
+
+        for(int y = y0; y < y1; ++y) {
+            for(int x = x0; x < x1; ++x) {
+                frame.WriteFragment<State>(x, y, point.Z, [&point] { return point.Color; });
+            }
+        }
+    }
+
+    // Binned point-sprite path: transform and bin in parallel over chunks, then splat in parallel over tiles, all on
+    // the workers of core::GetJobSystem. Intermediate storage comes from the calling thread's arena of context.
+    // Draws points[indices[k]] for every k when indices is given, otherwise every point in order
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void RenderPoints(FrameBuffer& frame, const Shader& shader, const shader::Vertex* points,
+                             const std::size_t pointCount, const std::uint32_t* indices, const std::size_t count,
+                             const PointSize& size = {}, RenderContext& context = GetDefaultContext()) {
+        TRACE_SCOPE("RenderPoints");
+
+        core::Arena& arena = context.GetArena();
+        const core::ArenaScope scope(arena);
+
+        const int width = static_cast<int>(frame.GetWidth());
+        const int height = static_cast<int>(frame.GetImageHeight());
+        const BoundingBox& scissor = frame.GetScissor();
+        if(!scissor.ShouldRender) return;
+
+        const int tilesX = (width + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+        const int tilesY = (height + POINT_TILE_SIZE - 1) / POINT_TILE_SIZE;
+        const std::size_t tileCount = static_cast<std::size_t>(tilesX) * tilesY;
+        const std::size_t chunkCount = (count + POINT_CHUNK_SIZE - 1) / POINT_CHUNK_SIZE;
+
+        core::JobSystem& jobs = core::GetJobSystem();
+        if(jobs.GetWorkerCount() == 1) {
+            TRACE_SCOPE("SplatPoints");
+
+            ScreenPoint* screenPoints = arena.Allocate<ScreenPoint>(count);
+            const std::size_t kept =
+                TransformPoints(shader, points, pointCount, indices, count, size, width, height, screenPoints);
+
+            for(std::size_t i = 0; i < kept; ++i) {
+                SplatPoint<State>(frame, screenPoints[i], scissor.MinX, scissor.MinY, scissor.MaxX + 1,
+                                  scissor.MaxY + 1);
+            }
+            return;
+        }
+
+        // Chunk c transforms into screenPoints + c * POINT_CHUNK_SIZE and keeps chunkSizes[c] of them
+        ScreenPoint* screenPoints = arena.Allocate<ScreenPoint>(count);
+        std::size_t* chunkSizes = arena.Allocate<std::size_t>(chunkCount);
+        std::uint32_t* offsets = arena.Allocate<std::uint32_t>(chunkCount * tileCount);
+        std::fill_n(offsets, chunkCount * tileCount, 0u);
+
+        auto ForEachTile = [tilesX, tilesY](const ScreenPoint& point, auto&& function) {
+            const int tx0 = std::max(0, point.X / POINT_TILE_SIZE);
+            const int ty0 = std::max(0, point.Y / POINT_TILE_SIZE);
+            const int tx1 = std::min(tilesX - 1, (point.X + point.Size - 1) / POINT_TILE_SIZE);
+            const int ty1 = std::min(tilesY - 1, (point.Y + point.Size - 1) / POINT_TILE_SIZE);
+
+            for(int ty = ty0; ty <= ty1; ++ty) {
+                for(int tx = tx0; tx <= tx1; ++tx) function(static_cast<std::size_t>(ty) * tilesX + tx);
+            }
+        };
+
+        jobs.For(chunkCount, [&](const std::size_t chunk) {
+            TRACE_SCOPE("TransformPoints");
+
+            const std::size_t first = chunk * POINT_CHUNK_SIZE;
+            const std::size_t length = std::min(POINT_CHUNK_SIZE, count - first);
+
+            ScreenPoint* chunkPoints = screenPoints + first;
+            chunkSizes[chunk] = indices ? TransformPoints(shader, points, pointCount, indices + first, length, size,
+                                                          width, height, chunkPoints)
+                                        : TransformPoints(shader, points + first, pointCount - first, nullptr, length,
+                                                          size, width, height, chunkPoints);
+
+            std::uint32_t* counts = offsets + chunk * tileCount;
+            for(std::size_t i = 0; i < chunkSizes[chunk]; ++i) {
+                ForEachTile(chunkPoints[i], [counts](const std::size_t tile) { ++counts[tile]; });
+            }
+        });
+
+        std::uint32_t* tileStarts = arena.Allocate<std::uint32_t>(tileCount + 1);
+        std::uint32_t total = 0;
+
+        for(std::size_t tile = 0; tile < tileCount; ++tile) {
+            tileStarts[tile] = total;
+
+            for(std::size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                const std::uint32_t count = offsets[chunk * tileCount + tile];
+                offsets[chunk * tileCount + tile] = total;
+                total += count;
+            }
+        }
+        tileStarts[tileCount] = total;
+
+        ScreenPoint* bins = arena.Allocate<ScreenPoint>(total);
+
+        jobs.For(chunkCount, [&](const std::size_t chunk) {
+            TRACE_SCOPE("BinPoints");
+
+            std::uint32_t* cursors = offsets + chunk * tileCount;
+            const ScreenPoint* chunkPoints = screenPoints + chunk * POINT_CHUNK_SIZE;
+
+            for(std::size_t i = 0; i < chunkSizes[chunk]; ++i) {
+                ForEachTile(chunkPoints[i], [&](const std::size_t tile) { bins[cursors[tile]++] = chunkPoints[i]; });
+            }
+        });
+
+        jobs.For(tileCount, [&](const std::size_t tile) {
+            TRACE_SCOPE("SplatTile");
+
+            const int tileX = static_cast<int>(tile % tilesX) * POINT_TILE_SIZE;
+            const int tileY = static_cast<int>(tile / tilesX) * POINT_TILE_SIZE;
+            const int minX = std::max(scissor.MinX, tileX);
+            const int minY = std::max(scissor.MinY, tileY);
+            const int maxX = std::min(scissor.MaxX + 1, tileX + POINT_TILE_SIZE);
+            const int maxY = std::min(scissor.MaxY + 1, tileY + POINT_TILE_SIZE);
+
+            for(std::uint32_t i = tileStarts[tile]; i < tileStarts[tile + 1]; ++i) {
+                SplatPoint<State>(frame, bins[i], minX, minY, maxX, maxY);
+            }
+        });
+    }
+
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void RenderPoints(FrameBuffer& frame, const Shader& shader, const std::vector<shader::Vertex>& points,
+                             const PointSize& size = {}, RenderContext& context = GetDefaultContext()) {
+        RenderPoints<State>(frame, shader, points.data(), points.size(), nullptr, points.size(), size, context);
+    }
+}
\ No newline at end of file
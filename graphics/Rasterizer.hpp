@@ -1,170 +1,471 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "../core/Arena.hpp"
+#include "../core/Trace.hpp"
 #include "../math/Math.hpp"
+#include "DepthBuffer.hpp"
 #include "FrameBuffer.hpp"
+#include "MultisampleBuffer.hpp"
+#include "PipelineState.hpp"
+#include "PointCloud.hpp"
+#include "RenderContext.hpp"
 #include "Shader.hpp"
+#include "TriangleSetup.hpp"
 
 namespace graphics {
     enum class PrimitiveType { Points, Lines, Triangles };
 
-    template <typename Shader>
+    constexpr inline int RASTER_BLOCK_SIZE = 8;
+
+    template <PipelineState State = PipelineState{}, typename Shader>
     inline void DrawPoint(FrameBuffer& frame, const Shader& shader, const shader::Vertex& v) {
+        if(!(v.Pos.X > -0.5f && v.Pos.X < frame.GetWidth() - 0.5f && v.Pos.Y > -0.5f &&
+             v.Pos.Y < frame.GetImageHeight() - 0.5f))
+            return;
+
         int x = static_cast<int>(std::round(v.Pos.X));
         int y = static_cast<int>(std::round(v.Pos.Y));
+        if(!Contains(frame.GetScissor(), x, y)) return;
+
+        frame.WriteFragment<State>(x, y, v.Pos.Z, [&] { return shader.Color(v.Color); });
+    }
+
+    // Liang-Barsky clipping against the viewport and the [0, 1] depth range
+    inline bool ClipLine(shader::Vertex& v0, shader::Vertex& v1, const float maxX, const float maxY) noexcept {
+        const math::Vector delta = v1.Pos - v0.Pos;
+
+        const float p[6] = {-delta.X, delta.X, -delta.Y, delta.Y, -delta.Z, delta.Z};
+        const float q[6] = {v0.Pos.X, maxX - v0.Pos.X, v0.Pos.Y, maxY - v0.Pos.Y, v0.Pos.Z, 1.f - v0.Pos.Z};
 
-        if(frame.IsVisible(x, y, v.Pos.Z)) {
-            frame.SetPixel(x, y, shader.Color(v.Color));
+        float t0 = 0.f;
+        float t1 = 1.f;
+
+        for(int i = 0; i < 6; ++i) {
+            if(p[i] == 0.f) {
+                if(q[i] < 0.f) return false;
+                continue;
+            }
+
+            const float r = q[i] / p[i];
+            if(p[i] < 0.f) t0 = std::max(t0, r);
+            else t1 = std::min(t1, r);
+
+            if(t0 > t1) return false;
         }
+
+        const shader::Vertex start = v0;
+        const math::Vector deltaColor = v1.Color - v0.Color;
+
+        if(t0 > 0.f) v0 = {start.Pos + delta * t0, start.Color + deltaColor * t0};
+        if(t1 < 1.f) v1 = {start.Pos + delta * t1, start.Color + deltaColor * t1};
+
+        return true;
     }
 
-    // Bresenham's Line Algorithm
-    template <typename Shader>
-    inline void DrawLine(FrameBuffer& frame, const Shader& shader, const shader::Vertex& v0, const shader::Vertex& v1) {
-        int x0 = static_cast<int>(std::round(v0.Pos.X));
-        int y0 = static_cast<int>(std::round(v0.Pos.Y));
-        int x1 = static_cast<int>(std::round(v1.Pos.X));
-        int y1 = static_cast<int>(std::round(v1.Pos.Y));
-
-        int dx = std::abs(x1 - x0);
-        int dy = std::abs(y1 - y0);
-        int sx = (x0 < x1) ? 1 : -1;
-        int sy = (y0 < y1) ? 1 : -1;
-        int err = dx - dy;
-
-        float totalDist = std::sqrt(static_cast<float>(dx * dx + dy * dy));
-        int startX = x0, startY = y0;
-
-        while(true) {
-            float t =
-                (totalDist < 1e-6f) ? 0.f : std::sqrt(std::pow(x0 - startX, 2) + std::pow(y0 - startY, 2)) / totalDist;
-
-            float z = v0.Pos.Z * (1.f - t) + v1.Pos.Z * t;
-            math::Vector color = v0.Color * (1.f - t) + v1.Color * t;
-
-            if(frame.IsVisible(x0, y0, z)) {
-                frame.SetPixel(x0, y0, shader.Color(color));
+    // Bresenham's Line Algorithm. Lines are clipped to the whole image and scissored per pixel, so a scissored
+    // redraw or a band lights exactly the pixels a full draw would
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void DrawLine(FrameBuffer& frame, const Shader& shader, shader::Vertex v0, shader::Vertex v1) {
+        if(!ClipLine(v0, v1, static_cast<float>(frame.GetWidth() - 1), static_cast<float>(frame.GetImageHeight() - 1)))
+            return;
+
+        int x = static_cast<int>(std::round(v0.Pos.X));
+        int y = static_cast<int>(std::round(v0.Pos.Y));
+        const int x1 = static_cast<int>(std::round(v1.Pos.X));
+        const int y1 = static_cast<int>(std::round(v1.Pos.Y));
+
+        const int dx = std::abs(x1 - x);
+        const int dy = std::abs(y1 - y);
+        const int sx = (x < x1) ? 1 : -1;
+        const int sy = (y < y1) ? 1 : -1;
+
+        const bool steep = dy > dx;
+        const int major = steep ? dy : dx;
+        const int minor = steep ? dx : dy;
+
+        const float invSteps = major > 0 ? 1.f / static_cast<float>(major) : 0.f;
+        const float dz = (v1.Pos.Z - v0.Pos.Z) * invSteps;
+        const math::Vector dColor = (v1.Color - v0.Color) * invSteps;
+
+        float z = v0.Pos.Z;
+        math::Vector color = v0.Color;
+        int err = 2 * minor - major;
+
+        const BoundingBox& scissor = frame.GetScissor();
+
+        for(int i = 0; i <= major; ++i) {
+            if(Contains(scissor, x, y)) frame.WriteFragment<State>(x, y, z, [&] { return shader.Color(color); });
+
+            if(err > 0) {
+                if(steep) x += sx;
+                else y += sy;
+                err -= 2 * major;
             }
 
-            if(x0 == x1 && y0 == y1) break;
+            if(steep) y += sy;
+            else x += sx;
+            err += 2 * minor;
+
+            z += dz;
+            color += dColor;
+        }
+    }
+
+    // Integer edge functions stepped across the pixel centers of [minX, maxX] x [minY, maxY]. Packed blend modes
+    // shade a whole block row first and blend it with one SIMD pass. Without a color write only depth is
+    // interpolated, with the same arithmetic as a color pass, so a later Equal test matches it exactly
+    template <PipelineState State, bool TestCoverage, typename Target, typename Shader>
+    inline void RasterizeBlock(Target& frame, const Shader& shader, const TriangleSetup& setup, const int minX,
+                               const int minY, const int maxX, const int maxY) {
+        const EdgeFunction* edges = setup.Edges;
+        const shader::Vertex& a = *setup.Vertices[0];
+        const shader::Vertex& b = *setup.Vertices[1];
+        const shader::Vertex& c = *setup.Vertices[2];
+
+        const std::int64_t startX = GetPixelCenter(minX);
+        const std::int64_t startY = GetPixelCenter(minY);
+
+        std::int64_t row0 = edges[0].Evaluate(startX, startY);
+        std::int64_t row1 = edges[1].Evaluate(startX, startY);
+        std::int64_t row2 = edges[2].Evaluate(startX, startY);
+
+        constexpr bool depthOnly = !State.ColorWrite || std::is_same_v<Target, DepthBuffer>;
+        constexpr bool batchRows = !depthOnly && IsPackedBlend(State.Blend);
+        assert(!batchRows || maxX - minX < RASTER_BLOCK_SIZE);
+
+        for(int y = minY; y <= maxY; ++y) {
+            std::int64_t w0 = row0;
+            std::int64_t w1 = row1;
+            std::int64_t w2 = row2;
+
+            std::uint32_t rowColors[RASTER_BLOCK_SIZE];
+            std::uint32_t rowMask = 0;
+
+            for(int x = minX; x <= maxX; ++x) {
+                if(!TestCoverage || (w0 | w1 | w2) >= 0) {
+                    const float b0 = static_cast<float>(w0) * setup.InvArea;
+                    const float b1 = static_cast<float>(w1) * setup.InvArea;
+                    const float b2 = static_cast<float>(w2) * setup.InvArea;
+
+                    const float z = a.Pos.Z * b0 + b.Pos.Z * b1 + c.Pos.Z * b2;
+                    auto Shade = [&] { return shader.Color((a.Color * b0) + (b.Color * b1) + (c.Color * b2)); };
+
+                    if constexpr(depthOnly) {
+                        frame.template TestDepth<State.Depth, State.DepthWrite>(x, y, z);
+                    } else if constexpr(batchRows) {
+                        if(frame.template TestDepth<State.Depth, State.DepthWrite>(x, y, z)) {
+                            rowColors[x - minX] = Shade();
+                            rowMask |= 1u << (x - minX);
+                        }
+                    } else {
+                        frame.template WriteFragment<State>(x, y, z, Shade);
+                    }
+                }
 
-            int e2 = 2 * err;
+                w0 += edges[0].A * SUBPIXEL_SCALE;
+                w1 += edges[1].A * SUBPIXEL_SCALE;
+                w2 += edges[2].A * SUBPIXEL_SCALE;
+            }
 
-            if(e2 > -dy) {
-                err -= dy;
-                x0 += sx;
+            if constexpr(batchRows) {
+                if(rowMask != 0) frame.template BlendRow<State.Blend>(minX, y, rowColors, maxX - minX + 1, rowMask);
             }
 
-            if(e2 < dx) {
-                err += dx;
-                y0 += sy;
+            row0 += edges[0].B * SUBPIXEL_SCALE;
+            row1 += edges[1].B * SUBPIXEL_SCALE;
+            row2 += edges[2].B * SUBPIXEL_SCALE;
+        }
+    }
+
+    // Small triangles walk their bounding box directly; larger ones are classified per block first so blocks
+    // outside an edge are skipped and blocks inside all edges are filled without coverage tests. Only pixels inside
+    // setup.Bound are touched, so callers may narrow it to split one triangle across several target regions
+    template <PipelineState State = PipelineState{}, typename Target, typename Shader>
+    inline void RasterizeTriangle(Target& frame, const Shader& shader, const TriangleSetup& setup) {
+        const BoundingBox& bound = setup.Bound;
+
+        if(bound.MaxX - bound.MinX < RASTER_BLOCK_SIZE && bound.MaxY - bound.MinY < RASTER_BLOCK_SIZE) {
+            RasterizeBlock<State, true>(frame, shader, setup, bound.MinX, bound.MinY, bound.MaxX, bound.MaxY);
+            return;
+        }
+
+        constexpr std::int64_t blockSpan = (RASTER_BLOCK_SIZE - 1) * SUBPIXEL_SCALE;
+
+        std::int64_t acceptOffsets[3];
+        std::int64_t rejectOffsets[3];
+
+        for(int i = 0; i < 3; ++i) {
+            const std::int64_t dx = setup.Edges[i].A * blockSpan;
+            const std::int64_t dy = setup.Edges[i].B * blockSpan;
+            acceptOffsets[i] = std::min<std::int64_t>(0, dx) + std::min<std::int64_t>(0, dy);
+            rejectOffsets[i] = std::max<std::int64_t>(0, dx) + std::max<std::int64_t>(0, dy);
+        }
+
+        for(int blockY = bound.MinY; blockY <= bound.MaxY; blockY += RASTER_BLOCK_SIZE) {
+            const int maxY = std::min(bound.MaxY, blockY + RASTER_BLOCK_SIZE - 1);
+
+            for(int blockX = bound.MinX; blockX <= bound.MaxX; blockX += RASTER_BLOCK_SIZE) {
+                const int maxX = std::min(bound.MaxX, blockX + RASTER_BLOCK_SIZE - 1);
+
+                const std::int64_t cornerX = GetPixelCenter(blockX);
+                const std::int64_t cornerY = GetPixelCenter(blockY);
+
+                bool outside = false;
+                bool inside = true;
+
+                for(int i = 0; i < 3; ++i) {
+                    const std::int64_t corner = setup.Edges[i].Evaluate(cornerX, cornerY);
+                    outside |= corner + rejectOffsets[i] < 0;
+                    inside &= corner + acceptOffsets[i] >= 0;
+                }
+
+                if(outside) continue;
+
+                if(inside) RasterizeBlock<State, false>(frame, shader, setup, blockX, blockY, maxX, maxY);
+                else RasterizeBlock<State, true>(frame, shader, setup, blockX, blockY, maxX, maxY);
             }
         }
     }
 
-    template <typename Shader>
+    template <PipelineState State = PipelineState{}, typename Shader>
     inline void DrawTriangle(FrameBuffer& frame, const Shader& shader, const shader::Vertex& v0,
                              const shader::Vertex& v1, const shader::Vertex& v2) {
-        if((v1.Pos.X - v0.Pos.X) * (v2.Pos.Y - v0.Pos.Y) - (v1.Pos.Y - v0.Pos.Y) * (v2.Pos.X - v0.Pos.X) > 0.f) return;
+        TriangleSetup setup;
+        if(!SetupTriangle<State.Cull>(v0, v1, v2, frame.GetScissor(), setup)) return;
+
+        RasterizeTriangle<State>(frame, shader, setup);
+    }
+
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void DrawTriangle(DepthBuffer& depth, const Shader& shader, const shader::Vertex& v0,
+                             const shader::Vertex& v1, const shader::Vertex& v2) {
+        TriangleSetup setup;
+        if(!SetupTriangle<State.Cull>(v0, v1, v2, depth.GetScissor(), setup)) return;
+
+        RasterizeTriangle<State>(depth, shader, setup);
+    }
+
+    // Sets up every triangle of a draw into one compact stream first, so the raster loop only sees survivors
+    template <PipelineState State = PipelineState{}, typename Target, typename Shader>
+    inline void DrawTriangles(Target& frame, const Shader& shader, const shader::Vertex* screenVertices,
+                              const std::size_t vertexCount, const std::uint32_t* indices,
+                              const std::size_t triangleCount, core::Arena& arena) {
+        TRACE_SCOPE("DrawTriangles");
+
+        TriangleSetup* setups = arena.Allocate<TriangleSetup>(triangleCount);
+        std::size_t setupCount;
+        {
+            TRACE_SCOPE("SetupTriangles");
+            setupCount = SetupTriangles<State.Cull>(screenVertices, vertexCount, indices, triangleCount,
+                                                    frame.GetScissor(), setups);
+        }
+
+        for(std::size_t i = 0; i < setupCount; ++i) RasterizeTriangle<State>(frame, shader, setups[i]);
+    }
+
+    // Coverage and depth are evaluated per sample, the shader runs once per pixel at its center
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void DrawTriangle(MultisampleBuffer& frame, const Shader& shader, const shader::Vertex& v0,
+                             const shader::Vertex& v1, const shader::Vertex& v2) {
+        static_assert(State.Blend == BlendMode::Opaque, "Multisampled targets only take opaque draws");
 
-        BoundingBox bound = frame.GetBound(v0.Pos, v1.Pos, v2.Pos);
+        TriangleSetup setup;
+        if(!SetupTriangle<State.Cull>(v0, v1, v2, frame.GetScissor(), setup, SUBPIXEL_HALF)) return;
+
+        const BoundingBox& bound = setup.Bound;
+        const EdgeFunction* edges = setup.Edges;
+        const shader::Vertex& a = *setup.Vertices[0];
+        const shader::Vertex& b = *setup.Vertices[1];
+        const shader::Vertex& c = *setup.Vertices[2];
+
+        const std::uint32_t samples = frame.GetSampleCount();
+        const std::int8_t(*pattern)[2] = frame.GetPattern();
+
+        std::int64_t offsets[8][3];
+        for(std::uint32_t s = 0; s < samples; ++s) {
+            for(int i = 0; i < 3; ++i) offsets[s][i] = edges[i].A * pattern[s][0] + edges[i].B * pattern[s][1];
+        }
+
+        float z[8];
 
         for(int y = bound.MinY; y <= bound.MaxY; ++y) {
             for(int x = bound.MinX; x <= bound.MaxX; ++x) {
-                const math::Vector currPos(static_cast<float>(x), static_cast<float>(y), 0.f);
-                math::Vector bary = math::GetBarycentric(currPos, v0.Pos, v1.Pos, v2.Pos);
+                const std::int64_t px = GetPixelCenter(x);
+                const std::int64_t py = GetPixelCenter(y);
+                const std::int64_t w[3] = {edges[0].Evaluate(px, py), edges[1].Evaluate(px, py),
+                                           edges[2].Evaluate(px, py)};
+
+                std::uint32_t coverage = 0;
+
+                for(std::uint32_t s = 0; s < samples; ++s) {
+                    const std::int64_t s0 = w[0] + offsets[s][0];
+                    const std::int64_t s1 = w[1] + offsets[s][1];
+                    const std::int64_t s2 = w[2] + offsets[s][2];
+                    if((s0 | s1 | s2) < 0) continue;
+
+                    coverage |= 1u << s;
+                    z[s] = (a.Pos.Z * static_cast<float>(s0) + b.Pos.Z * static_cast<float>(s1) +
+                            c.Pos.Z * static_cast<float>(s2)) *
+                           setup.InvArea;
+                }
 
-                if(bary.X < 0 || bary.Y < 0 || bary.Z < 0) continue;
+                if(coverage == 0) continue;
 
-                float z = v0.Pos.Z * bary.X + v1.Pos.Z * bary.Y + v2.Pos.Z * bary.Z;
-                if(frame.IsVisible(x, y, z)) {
-                    const math::Vector interpolated = (v0.Color * bary.X) + (v1.Color * bary.Y) + (v2.Color * bary.Z);
-                    frame.SetPixel(x, y, shader.Color(interpolated));
-                }
+                const std::uint32_t mask = frame.TestDepth<State.Depth, State.DepthWrite>(x, y, z, coverage);
+                if(!State.ColorWrite || mask == 0) continue;
+
+                const float b0 = static_cast<float>(w[0]) * setup.InvArea;
+                const float b1 = static_cast<float>(w[1]) * setup.InvArea;
+                const float b2 = static_cast<float>(w[2]) * setup.InvArea;
+
+                const math::Vector interpolated = (a.Color * b0) + (b.Color * b1) + (c.Color * b2);
+                frame.SetSamples(x, y, mask, shader.Color(interpolated));
             }
         }
     }
 
+    // Screen-space copies of the vertices, carved from arena
     template <typename Shader>
+    inline shader::Vertex* TransformVertices(const Shader& shader, const std::vector<shader::Vertex>& vertices,
+                                             core::Arena& arena) {
+        TRACE_SCOPE("TransformVertices");
+
+        shader::Vertex* screenVertices = arena.Allocate<shader::Vertex>(vertices.size());
+        for(std::size_t i = 0; i < vertices.size(); ++i) {
+            screenVertices[i] = {shader.Vertex(vertices[i].Pos), vertices[i].Color};
+        }
+
+        return screenVertices;
+    }
+
+    template <PipelineState State = PipelineState{}, typename Shader>
     inline void Render(FrameBuffer& frame, const Shader& shader, const std::vector<shader::Vertex>& vertices,
-                       PrimitiveType type = PrimitiveType::Triangles) {
-        std::vector<shader::Vertex> screenVertices;
-        for(const shader::Vertex& vertex : vertices) {
-            screenVertices.push_back({shader.Vertex(vertex.Pos), vertex.Color});
+                       PrimitiveType type = PrimitiveType::Triangles, RenderContext& context = GetDefaultContext()) {
+        TRACE_SCOPE("Render");
+        if constexpr(State.Blend == BlendMode::WeightedOIT) frame.EnableTransparency();
+
+        if(type == PrimitiveType::Points) {
+            RenderPoints<State>(frame, shader, vertices, {}, context);
+            return;
         }
 
-        switch(type) {
-        case PrimitiveType::Points:
-            for(const shader::Vertex& vertex : screenVertices) DrawPoint(frame, shader, vertex);
-            break;
+        core::Arena& arena = context.GetArena();
+        const core::ArenaScope scope(arena);
+
+        const std::size_t vertexCount = vertices.size();
+        const shader::Vertex* screenVertices = TransformVertices(shader, vertices, arena);
 
-        case PrimitiveType::Lines:
-            for(std::size_t i = 0; i < screenVertices.size(); i += 2) {
-                if(i + 1 < screenVertices.size()) DrawLine(frame, shader, screenVertices[i], screenVertices[i + 1]);
+        switch(type) {
+        case PrimitiveType::Lines: {
+            TRACE_SCOPE("DrawLines");
+            for(std::size_t i = 0; i < vertexCount; i += 2) {
+                if(i + 1 < vertexCount)
+                    DrawLine<State>(frame, shader, screenVertices[i], screenVertices[i + 1]);
             }
             break;
+        }
 
         default:
-            for(std::size_t i = 0; i < screenVertices.size(); i += 3) {
-                if(i + 2 < screenVertices.size())
-                    DrawTriangle(frame, shader, screenVertices[i], screenVertices[i + 1], screenVertices[i + 2]);
-            }
+            DrawTriangles<State>(frame, shader, screenVertices, vertexCount, nullptr, vertexCount / 3, arena);
             break;
         }
     }
 
-    template <typename Shader>
+    template <PipelineState State = PipelineState{}, typename Shader>
     inline void Render(FrameBuffer& frame, const Shader& shader, const std::vector<shader::Vertex>& vertices,
-                       const std::vector<std::uint32_t>& indices, PrimitiveType type = PrimitiveType::Triangles) {
-        std::vector<shader::Vertex> screenVertices;
-        screenVertices.reserve(vertices.size());
-
-        for(const shader::Vertex& vertex : vertices) {
-            screenVertices.push_back({shader.Vertex(vertex.Pos), vertex.Color});
+                       const std::vector<std::uint32_t>& indices, PrimitiveType type = PrimitiveType::Triangles,
+                       RenderContext& context = GetDefaultContext()) {
+        TRACE_SCOPE("Render");
+        if constexpr(State.Blend == BlendMode::WeightedOIT) frame.EnableTransparency();
+
+        if(type == PrimitiveType::Points) {
+            RenderPoints<State>(frame, shader, vertices.data(), vertices.size(), indices.data(), indices.size(), {},
+                                context);
+            return;
         }
 
-        switch(type) {
-        case PrimitiveType::Points:
-            for(const std::size_t& index : indices) {
-                if(index >= screenVertices.size()) continue;
+        core::Arena& arena = context.GetArena();
+        const core::ArenaScope scope(arena);
 
-                DrawPoint(frame, shader, screenVertices[index]);
-            }
-            break;
+        const std::size_t vertexCount = vertices.size();
+        const shader::Vertex* screenVertices = TransformVertices(shader, vertices, arena);
 
-        case PrimitiveType::Lines:
-            for(std::size_t i = 0; i < indices.size(); i += 3) {
-                if(i + 2 >= indices.size()) break;
-
-                if(indices[i] >= screenVertices.size() || indices[i + 1] >= screenVertices.size() ||
-                   indices[i + 2] >= screenVertices.size())
+        switch(type) {
+        case PrimitiveType::Lines: {
+            TRACE_SCOPE("DrawLines");
+            std::uint64_t* edges = arena.Allocate<std::uint64_t>(indices.size());
+            std::size_t edgeCount = 0;
+
+            auto AddEdge = [edges, &edgeCount](std::uint32_t a, std::uint32_t b) {
+                if(a > b) std::swap(a, b);
+                edges[edgeCount++] = (static_cast<std::uint64_t>(a) << 32) | b;
+            };
+
+            for(std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+                if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount ||
+                   indices[i + 2] >= vertexCount)
                     continue;
 
-                const shader::Vertex& v0 = screenVertices[indices[i]];
-                const shader::Vertex& v1 = screenVertices[indices[i + 1]];
-                const shader::Vertex& v2 = screenVertices[indices[i + 2]];
+                AddEdge(indices[i], indices[i + 1]);
+                AddEdge(indices[i + 1], indices[i + 2]);
+                AddEdge(indices[i + 2], indices[i]);
+            }
+
+            std::sort(edges, edges + edgeCount);
+            const std::uint64_t* last = std::unique(edges, edges + edgeCount);
 
-                DrawLine(frame, shader, v0, v1);
-                DrawLine(frame, shader, v1, v2);
-                DrawLine(frame, shader, v2, v0);
+            for(const std::uint64_t* edge = edges; edge != last; ++edge) {
+                DrawLine<State>(frame, shader, screenVertices[*edge >> 32], screenVertices[*edge & 0xFFFFFFFFu]);
             }
             break;
+        }
 
         default:
-            for(std::size_t i = 0; i < indices.size(); i += 3) {
-                if(indices[i] >= screenVertices.size() || indices[i + 1] >= screenVertices.size() ||
-                   indices[i + 2] >= screenVertices.size())
-                    continue;
-
-                const shader::Vertex& v0 = screenVertices[indices[i]];
-                const shader::Vertex& v1 = screenVertices[indices[i + 1]];
-                const shader::Vertex& v2 = screenVertices[indices[i + 2]];
-                DrawTriangle(frame, shader, v0, v1, v2);
-            }
+            DrawTriangles<State>(frame, shader, screenVertices, vertexCount, indices.data(), indices.size() / 3, arena);
             break;
         }
     }
+
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void Render(MultisampleBuffer& frame, const Shader& shader, const std::vector<shader::Vertex>& vertices,
+                       const std::vector<std::uint32_t>& indices, RenderContext& context = GetDefaultContext()) {
+        TRACE_SCOPE("Render");
+
+        core::Arena& arena = context.GetArena();
+        const core::ArenaScope scope(arena);
+
+        const std::size_t vertexCount = vertices.size();
+        const shader::Vertex* screenVertices = TransformVertices(shader, vertices, arena);
+
+        TRACE_SCOPE("DrawTriangles");
+        for(std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount ||
+               indices[i + 2] >= vertexCount)
+                continue;
+
+            DrawTriangle<State>(frame, shader, screenVertices[indices[i]], screenVertices[indices[i + 1]],
+                                screenVertices[indices[i + 2]]);
+        }
+    }
+
+    // Depth-only draw, e.g. a shadow map from the light's matrices; State's color and blend settings are ignored
+    template <PipelineState State = PipelineState{}, typename Shader>
+    inline void Render(DepthBuffer& depth, const Shader& shader, const std::vector<shader::Vertex>& vertices,
+                       const std::vector<std::uint32_t>& indices, RenderContext& context = GetDefaultContext()) {
+        TRACE_SCOPE("RenderDepth");
+
+        core::Arena& arena = context.GetArena();
+        const core::ArenaScope scope(arena);
+
+        const shader::Vertex* screenVertices = TransformVertices(shader, vertices, arena);
+        DrawTriangles<State>(depth, shader, screenVertices, vertices.size(), indices.data(), indices.size() / 3, arena);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "../core/Arena.hpp"
+#include "../core/Parallel.hpp"
+
+namespace graphics {
+    // Transient pipeline memory: one arena per worker, all reset together once the frame is done
+    class RenderContext {
+    public:
+        explicit RenderContext(const std::size_t workers = core::GetWorkerCount())
+            : arenas(std::max<std::size_t>(1, workers)) {}
+
+        inline core::Arena& GetArena(const std::size_t worker = 0) noexcept {
+            assert(worker < arenas.size() && "No arena for this worker");
+            return arenas[worker];
+        }
+
+        inline std::size_t GetWorkerCount() const noexcept { return arenas.size(); }
+
+        inline void EndFrame() noexcept {
+            for(core::Arena& arena : arenas) arena.Reset();
+        }
+
+    private:
+        std::vector<core::Arena> arenas;
+    };
+
+    // Used by Render calls that are not handed a context; per thread, so concurrent callers never share an arena
+    inline RenderContext& GetDefaultContext() {
+        thread_local RenderContext context;
+        return context;
+    }
+}
\ No newline at end of file
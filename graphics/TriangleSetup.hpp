@@ -0,0 +1,532 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "../math/Math.hpp"
+#include "FrameBuffer.hpp"
+#include "PipelineState.hpp"
+#include "Shader.hpp"
+
+namespace graphics {
+    // Vertices are snapped to a 28.4 fixed-point grid
+    constexpr inline int SUBPIXEL_BITS = 4;
+    constexpr inline std::int64_t SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+    constexpr inline std::int64_t SUBPIXEL_HALF = SUBPIXEL_SCALE / 2;
+
+    // Triangles reaching further than this many pixels off-screen are rejected so edge products fit in 64 bits
+    constexpr inline float GUARD_BAND = 16777216.f;
+
+    struct EdgeFunction {
+        std::int64_t A;
+        std::int64_t B;
+        std::int64_t C;
+
+        inline std::int64_t Evaluate(const std::int64_t x, const std::int64_t y) const noexcept {
+            return A * x + B * y + C;
+        }
+    };
+
+    struct TriangleSetup {
+        // Edges[i] is the edge opposite Vertices[i], so Edges[i] / area is the barycentric weight of Vertices[i]
+        EdgeFunction Edges[3];
+        const shader::Vertex* Vertices[3];
+        float InvArea;
+        BoundingBox Bound;
+    };
+
+    inline std::int64_t ToFixed(const float value) noexcept {
+        return static_cast<std::int64_t>(std::lround(value * static_cast<float>(SUBPIXEL_SCALE)));
+    }
+
+    // Edges that are neither top nor left lose their boundary samples, so shared edges are covered exactly once
+    inline EdgeFunction SetupEdge(const std::int64_t ax, const std::int64_t ay, const std::int64_t bx,
+                                  const std::int64_t by) noexcept {
+        const std::int64_t dx = bx - ax;
+        const std::int64_t dy = by - ay;
+        const bool isTopLeft = dy < 0 || (dy == 0 && dx > 0);
+
+        return {-dy, dx, dy * ax - dx * ay - (isTopLeft ? 0 : 1)};
+    }
+
+    // Edges and inverse area of a triangle that passed every rejection test, given its fixed-point corners and
+    // signed doubled area
+    inline void FinishSetup(const shader::Vertex& v0, const shader::Vertex& v1, const shader::Vertex& v2,
+                            std::int64_t (&x)[3], std::int64_t (&y)[3], std::int64_t area,
+                            TriangleSetup& setup) noexcept {
+        // Edge functions are positive inside once the winding is made counter-clockwise
+        setup.Vertices[0] = &v0;
+        setup.Vertices[1] = &v1;
+        setup.Vertices[2] = &v2;
+
+        if(area < 0) {
+            std::swap(setup.Vertices[1], setup.Vertices[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            area = -area;
+        }
+
+        setup.Edges[0] = SetupEdge(x[1], y[1], x[2], y[2]);
+        setup.Edges[1] = SetupEdge(x[2], y[2], x[0], y[0]);
+        setup.Edges[2] = SetupEdge(x[0], y[0], x[1], y[1]);
+        setup.InvArea = 1.f / static_cast<float>(area);
+    }
+
+    // The pixel bound is clamped to clip; sampleRadius widens it for sample positions off the pixel center, in
+    // subpixel units
+    template <CullMode Cull = CullMode::Back>
+    inline bool SetupTriangle(const shader::Vertex& v0, const shader::Vertex& v1, const shader::Vertex& v2,
+                              const BoundingBox& clip, TriangleSetup& setup,
+                              const std::int64_t sampleRadius = 0) noexcept {
+        if(!clip.ShouldRender) return false;
+
+        if(v0.Pos.Z < 0.f || v1.Pos.Z < 0.f || v2.Pos.Z < 0.f) return false;
+
+        for(const shader::Vertex* v : {&v0, &v1, &v2}) {
+            if(!(std::abs(v->Pos.X) < GUARD_BAND && std::abs(v->Pos.Y) < GUARD_BAND)) return false;
+        }
+
+        std::int64_t x[3] = {ToFixed(v0.Pos.X), ToFixed(v1.Pos.X), ToFixed(v2.Pos.X)};
+        std::int64_t y[3] = {ToFixed(v0.Pos.Y), ToFixed(v1.Pos.Y), ToFixed(v2.Pos.Y)};
+
+        const std::int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if(area == 0) return false;
+        if constexpr(Cull == CullMode::Back) {
+            if(area > 0) return false;
+        } else if constexpr(Cull == CullMode::Front) {
+            if(area < 0) return false;
+        }
+
+        const std::int64_t minX = (std::min({x[0], x[1], x[2]}) - SUBPIXEL_HALF - sampleRadius + SUBPIXEL_SCALE - 1) >>
+                                  SUBPIXEL_BITS;
+        const std::int64_t maxX = (std::max({x[0], x[1], x[2]}) - SUBPIXEL_HALF + sampleRadius) >> SUBPIXEL_BITS;
+        const std::int64_t minY = (std::min({y[0], y[1], y[2]}) - SUBPIXEL_HALF - sampleRadius + SUBPIXEL_SCALE - 1) >>
+                                  SUBPIXEL_BITS;
+        const std::int64_t maxY = (std::max({y[0], y[1], y[2]}) - SUBPIXEL_HALF + sampleRadius) >> SUBPIXEL_BITS;
+
+        BoundingBox& bound = setup.Bound;
+        bound.MinX = static_cast<int>(std::max<std::int64_t>(clip.MinX, minX));
+        bound.MaxX = static_cast<int>(std::min<std::int64_t>(clip.MaxX, maxX));
+        bound.MinY = static_cast<int>(std::max<std::int64_t>(clip.MinY, minY));
+        bound.MaxY = static_cast<int>(std::min<std::int64_t>(clip.MaxY, maxY));
+        bound.ShouldRender = bound.MinX <= bound.MaxX && bound.MinY <= bound.MaxY;
+        if(!bound.ShouldRender) return false;
+
+        FinishSetup(v0, v1, v2, x, y, area, setup);
+        return true;
+    }
+
+    constexpr inline std::size_t SETUP_BATCH_SIZE = 4;
+
+    // Lane by lane through SetupTriangle, for targets without SIMD and for batches holding a lane too wide for the
+    // batched area test
+    template <CullMode Cull>
+    inline std::size_t SetupTriangleLanes(const shader::Vertex* const (&corners)[SETUP_BATCH_SIZE][3],
+                                          const std::uint32_t lanes, const BoundingBox& clip,
+                                          TriangleSetup* out) noexcept {
+        std::size_t count = 0;
+        for(std::size_t lane = 0; lane < SETUP_BATCH_SIZE; ++lane) {
+            if(!((lanes >> lane) & 1u)) continue;
+            if(SetupTriangle<Cull>(*corners[lane][0], *corners[lane][1], *corners[lane][2], clip, out[count])) ++count;
+        }
+
+        return count;
+    }
+
+    // Sets up to SETUP_BATCH_SIZE triangles at once, lane i from corners[i] when bit i of lanes is set; inactive
+    // lanes must still point at readable vertices. Rejection tests, winding, edge functions, top-left bias, bounds
+    // and inverse area are all computed across lanes, and survivors are stored into out in lane order. Produces
+    // exactly what SetupTriangle would
+    template <CullMode Cull = CullMode::Back>
+    inline std::size_t SetupTriangleBatch(const shader::Vertex* const (&corners)[SETUP_BATCH_SIZE][3],
+                                          const std::uint32_t lanes, const BoundingBox& clip,
+                                          TriangleSetup* out) noexcept {
+        if(!clip.ShouldRender || lanes == 0) return 0;
+
+#ifdef ENGINE_SIMD_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 guard = _mm_set1_ps(GUARD_BAND);
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 scale = _mm_set1_ps(static_cast<float>(SUBPIXEL_SCALE));
+        const __m128i one = _mm_set1_epi32(1);
+
+        const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+        __m128 valid = _mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(lanes)), laneBits), laneBits));
+
+        // lround: truncate, then step away from zero when the dropped fraction is at least a half
+        auto Round = [&](const __m128 v) {
+            const __m128i truncated = _mm_cvttps_epi32(v);
+            const __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+            const __m128i up = _mm_castps_si128(_mm_cmpge_ps(_mm_and_ps(fraction, absMask), _mm_set1_ps(0.5f)));
+            const __m128i sign = _mm_or_si128(_mm_srai_epi32(_mm_castps_si128(v), 31), one);
+            return _mm_add_epi32(truncated, _mm_and_si128(up, sign));
+        };
+
+        auto Select = [](const __m128i mask, const __m128i a, const __m128i b) {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        };
+#ifdef ENGINE_SIMD_SSE41
+        auto Min = [](const __m128i a, const __m128i b) { return _mm_min_epi32(a, b); };
+        auto Max = [](const __m128i a, const __m128i b) { return _mm_max_epi32(a, b); };
+#else
+        auto Min = [&](const __m128i a, const __m128i b) { return Select(_mm_cmplt_epi32(a, b), a, b); };
+        auto Max = [&](const __m128i a, const __m128i b) { return Select(_mm_cmpgt_epi32(a, b), a, b); };
+#endif
+
+        __m128i x[3];
+        __m128i y[3];
+        for(int k = 0; k < 3; ++k) {
+            // Corner k of the four lanes, transposed into X, Y and Z across lanes
+            __m128 px = _mm_load_ps(&corners[0][k]->Pos.X);
+            __m128 py = _mm_load_ps(&corners[1][k]->Pos.X);
+            __m128 pz = _mm_load_ps(&corners[2][k]->Pos.X);
+            __m128 pw = _mm_load_ps(&corners[3][k]->Pos.X);
+            _MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+            valid = _mm_and_ps(valid, _mm_cmpnlt_ps(pz, zero));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(_mm_and_ps(px, absMask), guard));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(_mm_and_ps(py, absMask), guard));
+
+            x[k] = Round(_mm_mul_ps(px, scale));
+            y[k] = Round(_mm_mul_ps(py, scale));
+        }
+
+        const __m128i low = _mm_set1_epi32(static_cast<int>(SUBPIXEL_SCALE - 1 - SUBPIXEL_HALF));
+        const __m128i half = _mm_set1_epi32(static_cast<int>(SUBPIXEL_HALF));
+        const __m128i minX = Max(_mm_srai_epi32(_mm_add_epi32(Min(Min(x[0], x[1]), x[2]), low), SUBPIXEL_BITS),
+                                 _mm_set1_epi32(clip.MinX));
+        const __m128i maxX = Min(_mm_srai_epi32(_mm_sub_epi32(Max(Max(x[0], x[1]), x[2]), half), SUBPIXEL_BITS),
+                                 _mm_set1_epi32(clip.MaxX));
+        const __m128i minY = Max(_mm_srai_epi32(_mm_add_epi32(Min(Min(y[0], y[1]), y[2]), low), SUBPIXEL_BITS),
+                                 _mm_set1_epi32(clip.MinY));
+        const __m128i maxY = Min(_mm_srai_epi32(_mm_sub_epi32(Max(Max(y[0], y[1]), y[2]), half), SUBPIXEL_BITS),
+                                 _mm_set1_epi32(clip.MaxY));
+
+        const __m128i empty = _mm_or_si128(_mm_cmpgt_epi32(minX, maxX), _mm_cmpgt_epi32(minY, maxY));
+        valid = _mm_andnot_ps(_mm_castsi128_ps(empty), valid);
+
+        // SSE2 has no signed 64-bit product, so the area sign comes from doubles; they are exact while every
+        // corner difference stays below 2^26 subpixels, and batches with a wider lane go through SetupTriangleLanes
+        const __m128i dx1 = _mm_sub_epi32(x[1], x[0]);
+        const __m128i dy1 = _mm_sub_epi32(y[1], y[0]);
+        const __m128i dx2 = _mm_sub_epi32(x[2], x[0]);
+        const __m128i dy2 = _mm_sub_epi32(y[2], y[0]);
+
+        const __m128i limit = _mm_set1_epi32((1 << 26) - 1);
+        auto Wide = [&](const __m128i d) {
+            const __m128i sign = _mm_srai_epi32(d, 31);
+            return _mm_cmpgt_epi32(_mm_sub_epi32(_mm_xor_si128(d, sign), sign), limit);
+        };
+        const __m128i wideMask = _mm_or_si128(_mm_or_si128(Wide(dx1), Wide(dy1)), _mm_or_si128(Wide(dx2), Wide(dy2)));
+
+        auto Area = [](const __m128i a, const __m128i b, const __m128i c, const __m128i d) {
+            return _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b)),
+                              _mm_mul_pd(_mm_cvtepi32_pd(c), _mm_cvtepi32_pd(d)));
+        };
+        auto High = [](const __m128i v) { return _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 2, 3, 2)); };
+
+        const __m128d areaLow = Area(dx1, dy2, dy1, dx2);
+        const __m128d areaHigh = Area(High(dx1), High(dy2), High(dy1), High(dx2));
+        const __m128d zeroPd = _mm_setzero_pd();
+
+        auto Narrow = [](const __m128d low, const __m128d high) {
+            return _mm_shuffle_ps(_mm_castpd_ps(low), _mm_castpd_ps(high), _MM_SHUFFLE(2, 0, 2, 0));
+        };
+
+        const __m128 negative = Narrow(_mm_cmplt_pd(areaLow, zeroPd), _mm_cmplt_pd(areaHigh, zeroPd));
+        __m128 keep = Narrow(_mm_cmpneq_pd(areaLow, zeroPd), _mm_cmpneq_pd(areaHigh, zeroPd));
+        if constexpr(Cull == CullMode::Back) {
+            keep = _mm_and_ps(keep, negative);
+        } else if constexpr(Cull == CullMode::Front) {
+            keep = _mm_and_ps(keep, Narrow(_mm_cmpgt_pd(areaLow, zeroPd), _mm_cmpgt_pd(areaHigh, zeroPd)));
+        }
+
+        const std::uint32_t survivors = static_cast<std::uint32_t>(_mm_movemask_ps(_mm_and_ps(valid, keep)));
+        const std::uint32_t wide =
+            static_cast<std::uint32_t>(_mm_movemask_ps(_mm_and_ps(valid, _mm_castsi128_ps(wideMask))));
+        const std::uint32_t flipped = static_cast<std::uint32_t>(_mm_movemask_ps(negative));
+
+        if(wide != 0) return SetupTriangleLanes<Cull>(corners, lanes, clip, out);
+        if(survivors == 0) return 0;
+
+        // Negative areas swap corners 1 and 2 so the edge functions are positive inside; the doubled area is exact
+        // in the doubles, so converting it gives the same float as the scalar path
+        const __m128i flip = _mm_castps_si128(negative);
+        const __m128i cx[3] = {x[0], Select(flip, x[2], x[1]), Select(flip, x[1], x[2])};
+        const __m128i cy[3] = {y[0], Select(flip, y[2], y[1]), Select(flip, y[1], y[2])};
+
+        const __m128 area = _mm_and_ps(_mm_movelh_ps(_mm_cvtpd_ps(areaLow), _mm_cvtpd_ps(areaHigh)), absMask);
+        alignas(16) float invAreas[SETUP_BATCH_SIZE];
+        _mm_store_ps(invAreas, _mm_div_ps(_mm_set1_ps(1.f), area));
+
+#ifdef ENGINE_SIMD_SSE41
+        auto Multiply = [](const __m128i a, const __m128i b) { return _mm_mul_epi32(a, b); };
+        const __m128i px[3] = {cx[0], cx[1], cx[2]};
+        const __m128i py[3] = {cy[0], cy[1], cy[2]};
+#else
+        // SSE2 only multiplies unsigned, so the products run over corners moved by 2^offsetBits to be positive; the
+        // move leaves 2^offsetBits * (dy - dx) in C, taken back out below
+        constexpr int offsetBits = 28;
+        static_assert(GUARD_BAND * SUBPIXEL_SCALE <= (1 << offsetBits), "offset corners must stay positive");
+        auto Multiply = [](const __m128i a, const __m128i b) { return _mm_mul_epu32(a, b); };
+        const __m128i offset = _mm_set1_epi32(1 << offsetBits);
+        const __m128i px[3] = {_mm_add_epi32(cx[0], offset), _mm_add_epi32(cx[1], offset),
+                                 _mm_add_epi32(cx[2], offset)};
+        const __m128i py[3] = {_mm_add_epi32(cy[0], offset), _mm_add_epi32(cy[1], offset),
+                                 _mm_add_epi32(cy[2], offset)};
+#endif
+
+        // Multiply takes slots 0 and 2; lanes 1 and 3 are shifted down into them
+        __m128i oddX[3];
+        __m128i oddY[3];
+        for(int k = 0; k < 3; ++k) {
+            oddX[k] = _mm_srli_epi64(px[k], 32);
+            oddY[k] = _mm_srli_epi64(py[k], 32);
+        }
+
+        // Edge k runs from corner k + 1 to corner k + 2; C = ax * by - bx * ay - bias expands SetupEdge's
+        // dy * ax - dx * ay
+        alignas(16) std::int32_t edgeA[3][SETUP_BATCH_SIZE];
+        alignas(16) std::int32_t edgeB[3][SETUP_BATCH_SIZE];
+        alignas(16) std::int64_t edgeC[3][SETUP_BATCH_SIZE];
+        auto SetupEdges = [&](const int edge, const int a, const int b) {
+            const __m128i zeroi = _mm_setzero_si128();
+            const __m128i dx = _mm_sub_epi32(cx[b], cx[a]);
+            const __m128i dy = _mm_sub_epi32(cy[b], cy[a]);
+
+            const __m128i topLeft = _mm_or_si128(_mm_cmplt_epi32(dy, zeroi),
+                                                 _mm_and_si128(_mm_cmpeq_epi32(dy, zeroi), _mm_cmpgt_epi32(dx, zeroi)));
+            const __m128i bias = _mm_andnot_si128(topLeft, one);
+
+            const __m128i even = _mm_sub_epi64(Multiply(px[a], py[b]), Multiply(px[b], py[a]));
+            const __m128i odd = _mm_sub_epi64(Multiply(oddX[a], oddY[b]), Multiply(oddX[b], oddY[a]));
+
+            // The 64-bit amount subtracted from the products, as low and high 32-bit halves
+#ifdef ENGINE_SIMD_SSE41
+            const __m128i lowHalf = bias;
+            const __m128i highHalf = zeroi;
+#else
+            const __m128i moved = _mm_sub_epi32(dy, dx);
+            const __m128i lowHalf = _mm_or_si128(_mm_slli_epi32(moved, offsetBits), bias);
+            const __m128i highHalf = _mm_srai_epi32(moved, 32 - offsetBits);
+#endif
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(edgeA[edge]), _mm_sub_epi32(zeroi, dy));
+            _mm_store_si128(reinterpret_cast<__m128i*>(edgeB[edge]), dx);
+            _mm_store_si128(reinterpret_cast<__m128i*>(edgeC[edge]),
+                            _mm_sub_epi64(_mm_unpacklo_epi64(even, odd), _mm_unpacklo_epi32(lowHalf, highHalf)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(edgeC[edge] + 2),
+                            _mm_sub_epi64(_mm_unpackhi_epi64(even, odd), _mm_unpackhi_epi32(lowHalf, highHalf)));
+        };
+        SetupEdges(0, 1, 2);
+        SetupEdges(1, 2, 0);
+        SetupEdges(2, 0, 1);
+
+        alignas(16) std::int32_t bounds[4][SETUP_BATCH_SIZE];
+        _mm_store_si128(reinterpret_cast<__m128i*>(bounds[0]), minX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(bounds[1]), maxX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(bounds[2]), minY);
+        _mm_store_si128(reinterpret_cast<__m128i*>(bounds[3]), maxY);
+#elif defined(ENGINE_SIMD_NEON)
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        const float32x4_t guard = vdupq_n_f32(GUARD_BAND);
+        const float32x4_t scale = vdupq_n_f32(static_cast<float>(SUBPIXEL_SCALE));
+
+        const uint32_t laneArray[4] = {1, 2, 4, 8};
+        const uint32x4_t laneBits = vld1q_u32(laneArray);
+        uint32x4_t valid = vceqq_u32(vandq_u32(vdupq_n_u32(lanes), laneBits), laneBits);
+
+        // lround: truncate, then step away from zero when the dropped fraction is at least a half
+        auto Round = [](const float32x4_t v) {
+            const int32x4_t truncated = vcvtq_s32_f32(v);
+            const float32x4_t fraction = vsubq_f32(v, vcvtq_f32_s32(truncated));
+            const int32x4_t up = vreinterpretq_s32_u32(vcgeq_f32(vabsq_f32(fraction), vdupq_n_f32(0.5f)));
+            const int32x4_t sign = vorrq_s32(vshrq_n_s32(vreinterpretq_s32_f32(v), 31), vdupq_n_s32(1));
+            return vaddq_s32(truncated, vandq_s32(up, sign));
+        };
+
+        int32x4_t x[3];
+        int32x4_t y[3];
+        for(int k = 0; k < 3; ++k) {
+            // Corner k of the four lanes, transposed into X, Y and Z across lanes
+            const float32x4x2_t low = vtrnq_f32(vld1q_f32(&corners[0][k]->Pos.X), vld1q_f32(&corners[1][k]->Pos.X));
+            const float32x4x2_t high = vtrnq_f32(vld1q_f32(&corners[2][k]->Pos.X), vld1q_f32(&corners[3][k]->Pos.X));
+            const float32x4_t px = vcombine_f32(vget_low_f32(low.val[0]), vget_low_f32(high.val[0]));
+            const float32x4_t py = vcombine_f32(vget_low_f32(low.val[1]), vget_low_f32(high.val[1]));
+            const float32x4_t pz = vcombine_f32(vget_high_f32(low.val[0]), vget_high_f32(high.val[0]));
+
+            valid = vandq_u32(valid, vmvnq_u32(vcltq_f32(pz, zero)));
+            valid = vandq_u32(valid, vcltq_f32(vabsq_f32(px), guard));
+            valid = vandq_u32(valid, vcltq_f32(vabsq_f32(py), guard));
+
+            x[k] = Round(vmulq_f32(px, scale));
+            y[k] = Round(vmulq_f32(py, scale));
+        }
+
+        const int32x4_t low = vdupq_n_s32(static_cast<int>(SUBPIXEL_SCALE - 1 - SUBPIXEL_HALF));
+        const int32x4_t half = vdupq_n_s32(static_cast<int>(SUBPIXEL_HALF));
+        int32x4x4_t bound;
+        bound.val[0] = vmaxq_s32(vshrq_n_s32(vaddq_s32(vminq_s32(vminq_s32(x[0], x[1]), x[2]), low), SUBPIXEL_BITS),
+                                 vdupq_n_s32(clip.MinX));
+        bound.val[1] = vminq_s32(vshrq_n_s32(vsubq_s32(vmaxq_s32(vmaxq_s32(x[0], x[1]), x[2]), half), SUBPIXEL_BITS),
+                                 vdupq_n_s32(clip.MaxX));
+        bound.val[2] = vmaxq_s32(vshrq_n_s32(vaddq_s32(vminq_s32(vminq_s32(y[0], y[1]), y[2]), low), SUBPIXEL_BITS),
+                                 vdupq_n_s32(clip.MinY));
+        bound.val[3] = vminq_s32(vshrq_n_s32(vsubq_s32(vmaxq_s32(vmaxq_s32(y[0], y[1]), y[2]), half), SUBPIXEL_BITS),
+                                 vdupq_n_s32(clip.MaxY));
+
+        valid = vandq_u32(valid,
+                          vandq_u32(vcleq_s32(bound.val[0], bound.val[1]), vcleq_s32(bound.val[2], bound.val[3])));
+
+        alignas(16) std::int32_t bounds[4][SETUP_BATCH_SIZE];
+        for(int i = 0; i < 4; ++i) vst1q_s32(bounds[i], bound.val[i]);
+
+        // Widening multiplies keep the doubled area exact across the whole guard band
+        const int32x4_t dx1 = vsubq_s32(x[1], x[0]);
+        const int32x4_t dy1 = vsubq_s32(y[1], y[0]);
+        const int32x4_t dx2 = vsubq_s32(x[2], x[0]);
+        const int32x4_t dy2 = vsubq_s32(y[2], y[0]);
+
+        const int64x2_t areaLow =
+            vsubq_s64(vmull_s32(vget_low_s32(dx1), vget_low_s32(dy2)), vmull_s32(vget_low_s32(dy1), vget_low_s32(dx2)));
+        const int64x2_t areaHigh = vsubq_s64(vmull_s32(vget_high_s32(dx1), vget_high_s32(dy2)),
+                                             vmull_s32(vget_high_s32(dy1), vget_high_s32(dx2)));
+
+        const uint32x4_t negative = vcombine_u32(vmovn_u64(vcltzq_s64(areaLow)), vmovn_u64(vcltzq_s64(areaHigh)));
+        uint32x4_t keep = vmvnq_u32(vcombine_u32(vmovn_u64(vceqzq_s64(areaLow)), vmovn_u64(vceqzq_s64(areaHigh))));
+        if constexpr(Cull == CullMode::Back) {
+            keep = vandq_u32(keep, negative);
+        } else if constexpr(Cull == CullMode::Front) {
+            keep = vandq_u32(keep, vcombine_u32(vmovn_u64(vcgtzq_s64(areaLow)), vmovn_u64(vcgtzq_s64(areaHigh))));
+        }
+
+        // Doubles hold the area exactly below 2^53, so converting it gives the same float as the scalar path;
+        // batches with a larger one go through SetupTriangleLanes
+        const int64x2_t exact = vdupq_n_s64(std::int64_t{1} << 53);
+        const uint32x4_t wideMask = vcombine_u32(vmovn_u64(vcgeq_s64(vabsq_s64(areaLow), exact)),
+                                                 vmovn_u64(vcgeq_s64(vabsq_s64(areaHigh), exact)));
+
+        alignas(16) std::uint32_t flags[3][SETUP_BATCH_SIZE];
+        vst1q_u32(flags[0], vandq_u32(valid, keep));
+        vst1q_u32(flags[1], vandq_u32(valid, wideMask));
+        vst1q_u32(flags[2], negative);
+
+        std::uint32_t survivors = 0;
+        std::uint32_t wide = 0;
+        std::uint32_t flipped = 0;
+        for(std::uint32_t lane = 0; lane < SETUP_BATCH_SIZE; ++lane) {
+            survivors |= (flags[0][lane] & 1u) << lane;
+            wide |= (flags[1][lane] & 1u) << lane;
+            flipped |= (flags[2][lane] & 1u) << lane;
+        }
+
+        if(wide != 0) return SetupTriangleLanes<Cull>(corners, lanes, clip, out);
+        if(survivors == 0) return 0;
+
+        // Negative areas swap corners 1 and 2 so the edge functions are positive inside
+        const int32x4_t cx[3] = {x[0], vbslq_s32(negative, x[2], x[1]), vbslq_s32(negative, x[1], x[2])};
+        const int32x4_t cy[3] = {y[0], vbslq_s32(negative, y[2], y[1]), vbslq_s32(negative, y[1], y[2])};
+
+        const float32x4_t area = vabsq_f32(vcombine_f32(vcvt_f32_f64(vcvtq_f64_s64(areaLow)),
+                                                        vcvt_f32_f64(vcvtq_f64_s64(areaHigh))));
+        alignas(16) float invAreas[SETUP_BATCH_SIZE];
+        vst1q_f32(invAreas, vdivq_f32(vdupq_n_f32(1.f), area));
+
+        // Edge k runs from corner k + 1 to corner k + 2; C = ax * by - bx * ay - bias expands SetupEdge's
+        // dy * ax - dx * ay
+        alignas(16) std::int32_t edgeA[3][SETUP_BATCH_SIZE];
+        alignas(16) std::int32_t edgeB[3][SETUP_BATCH_SIZE];
+        alignas(16) std::int64_t edgeC[3][SETUP_BATCH_SIZE];
+        auto SetupEdges = [&](const int edge, const int a, const int b) {
+            const int32x4_t dx = vsubq_s32(cx[b], cx[a]);
+            const int32x4_t dy = vsubq_s32(cy[b], cy[a]);
+
+            const uint32x4_t topLeft = vorrq_u32(vcltzq_s32(dy), vandq_u32(vceqzq_s32(dy), vcgtzq_s32(dx)));
+            const int32x4_t bias = vbicq_s32(vdupq_n_s32(1), vreinterpretq_s32_u32(topLeft));
+
+            const int64x2_t lowC = vsubq_s64(vsubq_s64(vmull_s32(vget_low_s32(cx[a]), vget_low_s32(cy[b])),
+                                                       vmull_s32(vget_low_s32(cx[b]), vget_low_s32(cy[a]))),
+                                             vmovl_s32(vget_low_s32(bias)));
+            const int64x2_t highC = vsubq_s64(vsubq_s64(vmull_s32(vget_high_s32(cx[a]), vget_high_s32(cy[b])),
+                                                        vmull_s32(vget_high_s32(cx[b]), vget_high_s32(cy[a]))),
+                                              vmovl_s32(vget_high_s32(bias)));
+
+            vst1q_s32(edgeA[edge], vnegq_s32(dy));
+            vst1q_s32(edgeB[edge], dx);
+            vst1q_s64(edgeC[edge], lowC);
+            vst1q_s64(edgeC[edge] + 2, highC);
+        };
+        SetupEdges(0, 1, 2);
+        SetupEdges(1, 2, 0);
+        SetupEdges(2, 0, 1);
+#endif
+
+#if defined(ENGINE_SIMD_SSE) || defined(ENGINE_SIMD_NEON)
+        std::size_t count = 0;
+        for(std::size_t lane = 0; lane < SETUP_BATCH_SIZE; ++lane) {
+            if(!((survivors >> lane) & 1u)) continue;
+
+            TriangleSetup& setup = out[count++];
+            setup.Edges[0] = {edgeA[0][lane], edgeB[0][lane], edgeC[0][lane]};
+            setup.Edges[1] = {edgeA[1][lane], edgeB[1][lane], edgeC[1][lane]};
+            setup.Edges[2] = {edgeA[2][lane], edgeB[2][lane], edgeC[2][lane]};
+
+            const bool swap = (flipped >> lane) & 1u;
+            setup.Vertices[0] = corners[lane][0];
+            setup.Vertices[1] = corners[lane][swap ? 2 : 1];
+            setup.Vertices[2] = corners[lane][swap ? 1 : 2];
+            setup.InvArea = invAreas[lane];
+            setup.Bound = {bounds[0][lane], bounds[1][lane], bounds[2][lane], bounds[3][lane], true};
+        }
+
+        return count;
+#else
+        return SetupTriangleLanes<Cull>(corners, lanes, clip, out);
+#endif
+    }
+
+    // The setup stage of a draw: triangle t uses indices[3t..3t+2], or vertices 3t..3t+2 when indices is null.
+    // Triangles naming a vertex past vertexCount are skipped. Survivors are written to out in submission order,
+    // which needs room for triangleCount entries; returns how many were written
+    template <CullMode Cull = CullMode::Back>
+    inline std::size_t SetupTriangles(const shader::Vertex* vertices, const std::size_t vertexCount,
+                                      const std::uint32_t* indices, const std::size_t triangleCount,
+                                      const BoundingBox& clip, TriangleSetup* out) noexcept {
+        if(vertexCount == 0) return 0;
+        std::size_t count = 0;
+
+        for(std::size_t first = 0; first < triangleCount; first += SETUP_BATCH_SIZE) {
+            const shader::Vertex* corners[SETUP_BATCH_SIZE][3];
+            std::uint32_t lanes = 0;
+
+            for(std::size_t lane = 0; lane < SETUP_BATCH_SIZE; ++lane) {
+                const std::size_t base = (first + lane) * 3;
+                std::size_t corner[3] = {0, 0, 0};
+
+                if(first + lane < triangleCount) {
+                    for(int k = 0; k < 3; ++k) corner[k] = indices ? indices[base + k] : base + k;
+
+                    if(corner[0] < vertexCount && corner[1] < vertexCount && corner[2] < vertexCount) {
+                        lanes |= 1u << lane;
+                    } else {
+                        corner[0] = corner[1] = corner[2] = 0;
+                    }
+                }
+
+                for(int k = 0; k < 3; ++k) corners[lane][k] = vertices + corner[k];
+            }
+
+            count += SetupTriangleBatch<Cull>(corners, lanes, clip, out + count);
+        }
+
+        return count;
+    }
+
+    // Fixed-point position of the center of pixel (x, y)
+    inline std::int64_t GetPixelCenter(const int coord) noexcept {
+        return static_cast<std::int64_t>(coord) * SUBPIXEL_SCALE + SUBPIXEL_HALF;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace io {
+    // Binary PPM (P6) written a few rows at a time, so an image larger than memory can be produced band by band.
+    // Alpha is dropped on write and read back as opaque
+    class ImageWriter {
+    public:
+        ImageWriter(const char* path, const std::uint32_t width, const std::uint32_t height)
+            : file(std::fopen(path, "wb")), width(width), height(height), row(static_cast<std::size_t>(width) * 3) {
+            ok = file && std::fprintf(file, "P6\n%u %u\n255\n", width, height) > 0;
+        }
+
+        ~ImageWriter() { Close(); }
+
+        ImageWriter(const ImageWriter&) = delete;
+        ImageWriter& operator=(const ImageWriter&) = delete;
+
+        // Appends rows of width packed colors below the ones already written
+        inline bool WriteRows(const std::uint32_t* pixels, const std::uint32_t rows) {
+            if(!ok || rows > height - written) return ok = false;
+
+            for(std::uint32_t y = 0; y < rows && ok; ++y) {
+                const std::uint32_t* source = pixels + static_cast<std::size_t>(y) * width;
+                for(std::uint32_t x = 0; x < width; ++x) {
+                    row[x * 3] = static_cast<std::uint8_t>(source[x]);
+                    row[x * 3 + 1] = static_cast<std::uint8_t>(source[x] >> 8);
+                    row[x * 3 + 2] = static_cast<std::uint8_t>(source[x] >> 16);
+                }
+
+                ok = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+            }
+
+            written += rows;
+            return ok;
+        }
+
+        // True only if every row of the image was written and the file closed cleanly
+        inline bool Close() {
+            if(!file) return ok;
+
+            ok = std::fclose(file) == 0 && ok && written == height;
+            file = nullptr;
+            return ok;
+        }
+
+        inline std::uint32_t GetRowsWritten() const noexcept { return written; }
+
+    private:
+        std::FILE* file;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t written = 0;
+        bool ok;
+        std::vector<std::uint8_t> row;
+    };
+
+    inline bool WriteImage(const char* path, const std::uint32_t* pixels, const std::uint32_t width,
+                           const std::uint32_t height) {
+        ImageWriter writer(path, width, height);
+        return writer.WriteRows(pixels, height) && writer.Close();
+    }
+
+    inline bool ReadImage(const char* path, std::vector<std::uint32_t>& pixels, std::uint32_t& width,
+                          std::uint32_t& height) {
+        std::FILE* file = std::fopen(path, "rb");
+        if(!file) return false;
+
+        unsigned maxValue = 0;
+        const bool header = std::fscanf(file, "P6 %u %u %u", &width, &height, &maxValue) == 3 && maxValue == 255 &&
+                            std::fgetc(file) != EOF;
+
+        if(!header) {
+            std::fclose(file);
+            return false;
+        }
+
+        std::vector<std::uint8_t> bytes(static_cast<std::size_t>(width) * height * 3);
+        const bool ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        std::fclose(file);
+        if(!ok) return false;
+
+        pixels.resize(static_cast<std::size_t>(width) * height);
+        for(std::size_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = 0xFF000000u | static_cast<std::uint32_t>(bytes[i * 3 + 2]) << 16 |
+                        static_cast<std::uint32_t>(bytes[i * 3 + 1]) << 8 | bytes[i * 3];
+        }
+
+        return true;
+    }
+
+    struct ImageDiff {
+        std::uint32_t MaxError = 0;
+        std::size_t Mismatches = 0;
+    };
+
+    // Compares the color channels; a pixel mismatches when any channel differs by more than tolerance
+    inline ImageDiff CompareImages(const std::uint32_t* a, const std::uint32_t* b, const std::size_t count,
+                                   const std::uint32_t tolerance = 0) noexcept {
+        ImageDiff diff;
+
+        for(std::size_t i = 0; i < count; ++i) {
+            std::uint32_t error = 0;
+
+            for(int shift = 0; shift < 24; shift += 8) {
+                const int delta = static_cast<int>((a[i] >> shift) & 0xFFu) - static_cast<int>((b[i] >> shift) & 0xFFu);
+                error = std::max(error, static_cast<std::uint32_t>(std::abs(delta)));
+            }
+
+            diff.MaxError = std::max(diff.MaxError, error);
+            if(error > tolerance) ++diff.Mismatches;
+        }
+
+        return diff;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "../core/Trace.hpp"
+#include "../math/SIMD.hpp"
+
+namespace io {
+    // BT.601 limited range in 8-bit fixed point; pixels are RGBA8 with red in the low byte. The SIMD paths evaluate
+    // the same integer formulas, so every backend produces identical planes
+    inline std::uint8_t ToLuma(const int r, const int g, const int b) noexcept {
+        return static_cast<std::uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    inline std::uint8_t ToChromaU(const int r, const int g, const int b) noexcept {
+        return static_cast<std::uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    }
+
+    inline std::uint8_t ToChromaV(const int r, const int g, const int b) noexcept {
+        return static_cast<std::uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    inline void ConvertLumaRow(const std::uint32_t* rgba, std::uint8_t* y, const std::uint32_t width) noexcept {
+        std::uint32_t x = 0;
+
+#ifdef ENGINE_SIMD_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+        const __m128i bias = _mm_set1_epi32(128);
+
+        // Four pixels: the multiply-add leaves 66R + 129G and 25B per pixel, which are then folded together
+        auto Luma4 = [&](const __m128i pixels) {
+            const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+            const __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+            const __m128i lowSums = _mm_add_epi32(low, _mm_srli_epi64(low, 32));
+            const __m128i highSums = _mm_add_epi32(high, _mm_srli_epi64(high, 32));
+
+            const __m128i sums = _mm_unpacklo_epi64(_mm_shuffle_epi32(lowSums, _MM_SHUFFLE(2, 0, 2, 0)),
+                                                    _mm_shuffle_epi32(highSums, _MM_SHUFFLE(2, 0, 2, 0)));
+            return _mm_srli_epi32(_mm_add_epi32(sums, bias), 8);
+        };
+
+        for(; x + 16 <= width; x += 16) {
+            const __m128i* in = reinterpret_cast<const __m128i*>(rgba + x);
+            const __m128i first = _mm_packs_epi32(Luma4(_mm_loadu_si128(in)), Luma4(_mm_loadu_si128(in + 1)));
+            const __m128i second = _mm_packs_epi32(Luma4(_mm_loadu_si128(in + 2)), Luma4(_mm_loadu_si128(in + 3)));
+            const __m128i luma = _mm_add_epi8(_mm_packus_epi16(first, second), _mm_set1_epi8(16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), luma);
+        }
+#elif defined(ENGINE_SIMD_NEON)
+        for(; x + 16 <= width; x += 16) {
+            const uint8x16x4_t pixels = vld4q_u8(reinterpret_cast<const std::uint8_t*>(rgba + x));
+
+            auto Luma8 = [](const uint8x8_t r, const uint8x8_t g, const uint8x8_t b) {
+                uint16x8_t sum = vmull_u8(r, vdup_n_u8(66));
+                sum = vmlal_u8(sum, g, vdup_n_u8(129));
+                sum = vmlal_u8(sum, b, vdup_n_u8(25));
+                return vadd_u8(vshrn_n_u16(vaddq_u16(sum, vdupq_n_u16(128)), 8), vdup_n_u8(16));
+            };
+
+            const uint8x8_t low = Luma8(vget_low_u8(pixels.val[0]), vget_low_u8(pixels.val[1]),
+                                        vget_low_u8(pixels.val[2]));
+            const uint8x8_t high = Luma8(vget_high_u8(pixels.val[0]), vget_high_u8(pixels.val[1]),
+                                         vget_high_u8(pixels.val[2]));
+            vst1q_u8(y + x, vcombine_u8(low, high));
+        }
+#endif
+
+        for(; x < width; ++x) {
+            const std::uint32_t c = rgba[x];
+            y[x] = ToLuma(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF);
+        }
+    }
+
+    // One chroma row from two luma rows, each chroma sample from the rounded mean of a 2x2 block; a missing column
+    // or row repeats the last one
+    inline void ConvertChromaRow(const std::uint32_t* row0, const std::uint32_t* row1, std::uint8_t* u,
+                                 std::uint8_t* v, const std::uint32_t width) noexcept {
+        const std::uint32_t chromaWidth = (width + 1) / 2;
+        std::uint32_t x = 0;
+
+#ifdef ENGINE_SIMD_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        const __m128i weightsU = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+        const __m128i weightsV = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+        const __m128i bias = _mm_set1_epi32(128);
+
+        // Two 2x2 blocks from four pixels of each row, as 16-bit channel means
+        auto Means = [&](const __m128i top, const __m128i bottom) {
+            const __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            const __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            const __m128i sums = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+            return _mm_srli_epi16(_mm_add_epi16(sums, two), 2);
+        };
+
+        auto Chroma = [&](const __m128i first, const __m128i second, const __m128i weights) {
+            const __m128i low = _mm_madd_epi16(first, weights);
+            const __m128i high = _mm_madd_epi16(second, weights);
+            const __m128i lowSums = _mm_add_epi32(low, _mm_srli_epi64(low, 32));
+            const __m128i highSums = _mm_add_epi32(high, _mm_srli_epi64(high, 32));
+
+            const __m128i sums = _mm_unpacklo_epi64(_mm_shuffle_epi32(lowSums, _MM_SHUFFLE(2, 0, 2, 0)),
+                                                    _mm_shuffle_epi32(highSums, _MM_SHUFFLE(2, 0, 2, 0)));
+            return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sums, bias), 8), bias);
+        };
+
+        for(; 2 * x + 16 <= width; x += 8) {
+            const __m128i* top = reinterpret_cast<const __m128i*>(row0 + 2 * x);
+            const __m128i* bottom = reinterpret_cast<const __m128i*>(row1 + 2 * x);
+
+            __m128i means[4];
+            for(int i = 0; i < 4; ++i) means[i] = Means(_mm_loadu_si128(top + i), _mm_loadu_si128(bottom + i));
+
+            const __m128i chromaU = _mm_packs_epi32(Chroma(means[0], means[1], weightsU),
+                                                    Chroma(means[2], means[3], weightsU));
+            const __m128i chromaV = _mm_packs_epi32(Chroma(means[0], means[1], weightsV),
+                                                    Chroma(means[2], means[3], weightsV));
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x), _mm_packus_epi16(chromaU, chromaU));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x), _mm_packus_epi16(chromaV, chromaV));
+        }
+#elif defined(ENGINE_SIMD_NEON)
+        for(; 2 * x + 16 <= width; x += 8) {
+            const uint8x16x4_t top = vld4q_u8(reinterpret_cast<const std::uint8_t*>(row0 + 2 * x));
+            const uint8x16x4_t bottom = vld4q_u8(reinterpret_cast<const std::uint8_t*>(row1 + 2 * x));
+
+            int16x8_t means[3];
+            for(int channel = 0; channel < 3; ++channel) {
+                const uint16x8_t sums = vaddq_u16(vpaddlq_u8(top.val[channel]), vpaddlq_u8(bottom.val[channel]));
+                means[channel] = vreinterpretq_s16_u16(vrshrq_n_u16(sums, 2));
+            }
+
+            auto Chroma = [&means](const std::int16_t wr, const std::int16_t wg, const std::int16_t wb) {
+                int16x8_t sum = vmulq_n_s16(means[0], wr);
+                sum = vmlaq_n_s16(sum, means[1], wg);
+                sum = vmlaq_n_s16(sum, means[2], wb);
+                const int16x8_t shifted = vshrq_n_s16(vaddq_s16(sum, vdupq_n_s16(128)), 8);
+                return vqmovun_s16(vaddq_s16(shifted, vdupq_n_s16(128)));
+            };
+
+            vst1_u8(u + x, Chroma(-38, -74, 112));
+            vst1_u8(v + x, Chroma(112, -94, -18));
+        }
+#endif
+
+        for(; x < chromaWidth; ++x) {
+            const std::uint32_t left = 2 * x;
+            const std::uint32_t right = std::min(left + 1, width - 1);
+            const std::uint32_t block[4] = {row0[left], row0[right], row1[left], row1[right]};
+
+            int channels[3] = {0, 0, 0};
+            for(const std::uint32_t c : block) {
+                for(int channel = 0; channel < 3; ++channel) channels[channel] += (c >> (8 * channel)) & 0xFF;
+            }
+            for(int& channel : channels) channel = (channel + 2) >> 2;
+
+            u[x] = ToChromaU(channels[0], channels[1], channels[2]);
+            v[x] = ToChromaV(channels[0], channels[1], channels[2]);
+        }
+    }
+
+    // stdout switched to binary, since text mode on Windows would expand every 0x0A byte of a frame
+    inline std::FILE* GetBinaryStdout() noexcept {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
+
+    // Planar Y, then U and V at half resolution in both directions, rounded up for odd sizes
+    struct I420Frame {
+        std::vector<std::uint8_t> Data;
+        std::uint32_t Width = 0;
+        std::uint32_t Height = 0;
+
+        inline void Resize(const std::uint32_t width, const std::uint32_t height) {
+            Width = width;
+            Height = height;
+            Data.resize(static_cast<std::size_t>(width) * height + 2 * GetChromaSize());
+        }
+
+        inline std::size_t GetChromaSize() const noexcept {
+            return static_cast<std::size_t>((Width + 1) / 2) * ((Height + 1) / 2);
+        }
+
+        inline std::uint8_t* GetY() noexcept { return Data.data(); }
+        inline std::uint8_t* GetU() noexcept { return Data.data() + static_cast<std::size_t>(Width) * Height; }
+        inline std::uint8_t* GetV() noexcept { return GetU() + GetChromaSize(); }
+    };
+
+    inline void ConvertToI420(const std::uint32_t* rgba, const std::uint32_t width, const std::uint32_t height,
+                              I420Frame& out) {
+        TRACE_SCOPE("ConvertToI420");
+
+        out.Resize(width, height);
+        const std::uint32_t chromaWidth = (width + 1) / 2;
+
+        for(std::uint32_t y = 0; y < height; ++y) ConvertLumaRow(rgba + y * width, out.GetY() + y * width, width);
+
+        for(std::uint32_t y = 0; y < (height + 1) / 2; ++y) {
+            const std::uint32_t* row0 = rgba + 2 * y * width;
+            const std::uint32_t* row1 = 2 * y + 1 < height ? row0 + width : row0;
+            ConvertChromaRow(row0, row1, out.GetU() + y * chromaWidth, out.GetV() + y * chromaWidth, width);
+        }
+    }
+
+    // Raw YUV4MPEG2 stream. Submit converts the frame on the calling thread into the free one of two I420 buffers
+    // and returns while a writer thread drains the other, so writing overlaps rendering of the next frame. Submit
+    // only blocks when the writer is a whole frame behind
+    class VideoStream {
+    public:
+        VideoStream(std::FILE* file, const std::uint32_t width, const std::uint32_t height,
+                    const std::uint32_t framesPerSecond)
+            : file(file), width(width), height(height) {
+            std::fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+            writer = std::thread([this] { Write(); });
+        }
+
+        ~VideoStream() { Finish(); }
+
+        VideoStream(const VideoStream&) = delete;
+        VideoStream& operator=(const VideoStream&) = delete;
+
+        inline bool Submit(const std::uint32_t* rgba) {
+            TRACE_SCOPE("SubmitFrame");
+
+            I420Frame& frame = buffers[next];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return !queued[next] || failed; });
+                if(failed) return false;
+            }
+
+            ConvertToI420(rgba, width, height, frame);
+
+            {
+                const std::lock_guard<std::mutex> lock(mutex);
+                queued[next] = true;
+            }
+            changed.notify_all();
+
+            next ^= 1;
+            return true;
+        }
+
+        // Waits for every submitted frame to reach the file; returns false if a write failed
+        inline bool Finish() {
+            if(writer.joinable()) {
+                {
+                    const std::lock_guard<std::mutex> lock(mutex);
+                    finishing = true;
+                }
+                changed.notify_all();
+                writer.join();
+                std::fflush(file);
+            }
+
+            return !failed;
+        }
+
+        inline std::uint64_t GetFrameCount() const noexcept { return written.load(std::memory_order_relaxed); }
+
+    private:
+        inline void Write() {
+            for(int current = 0;; current ^= 1) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&] { return queued[current] || finishing; });
+                    if(!queued[current]) return;
+                }
+
+                bool ok;
+                {
+                    TRACE_SCOPE("WriteFrame");
+                    const std::vector<std::uint8_t>& data = buffers[current].Data;
+                    ok = std::fputs("FRAME\n", file) >= 0 &&
+                         std::fwrite(data.data(), 1, data.size(), file) == data.size();
+                }
+
+                {
+                    const std::lock_guard<std::mutex> lock(mutex);
+                    queued[current] = false;
+                    failed |= !ok;
+                    if(ok) written.fetch_add(1, std::memory_order_relaxed);
+                }
+                changed.notify_all();
+
+                if(!ok) return;
+            }
+        }
+
+        std::FILE* file;
+        std::uint32_t width;
+        std::uint32_t height;
+
+        I420Frame buffers[2];
+        bool queued[2] = {false, false};
+        int next = 0;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool finishing = false;
+        bool failed = false;
+        std::atomic<std::uint64_t> written{0};
+
+        std::thread writer;
+    };
+}
\ No newline at end of file
@@ -1,17 +1,166 @@
 ﻿#include <GLFW/glfw3.h>
 #include <gl/gl.h>
 
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 #include "World.hpp"
+#include "core/JobSystem.hpp"
+#include "core/Trace.hpp"
+#include "graphics/BandRender.hpp"
+#include "graphics/BatchRender.hpp"
+#include "graphics/Binning.hpp"
+#include "graphics/DirtyRegion.hpp"
 #include "graphics/FrameBuffer.hpp"
 #include "graphics/Rasterizer.hpp"
+#include "graphics/RenderContext.hpp"
+#include "io/Image.hpp"
+#include "io/Video.hpp"
+#include "mesh/Lod.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Optimizer.hpp"
+#include "regression/Bench.hpp"
+#include "regression/Golden.hpp"
+#include "regression/Simd.hpp"
 
 void ErrCallback(int error, const char* description) {
     std::fprintf(stderr, "ERROR : %s\n", description);
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // --golden [dir] checks the regression scenes headlessly against the committed references, --update-golden [dir]
+    // rewrites them after an intended change in output
+    if((argc == 2 || argc == 3) &&
+       (std::strcmp(argv[1], "--golden") == 0 || std::strcmp(argv[1], "--update-golden") == 0)) {
+        regression::Options options;
+        options.Update = std::strcmp(argv[1], "--update-golden") == 0;
+        return regression::RunGolden(argc == 3 ? argv[2] : regression::GOLDEN_DIRECTORY, options) == 0 ? 0 : 1;
+    }
+
+    // --bench-batch [count] times the math::Batch kernels against the per-element operators on each dispatch target
+    if((argc == 2 || argc == 3) && std::strcmp(argv[1], "--bench-batch") == 0) {
+        return regression::RunBatchBench(argc == 3 ? std::strtoul(argv[2], nullptr, 10) : 1024);
+    }
+
+    // --check-simd runs every SIMD path of this build against the scalar code it replaces
+    if(argc == 2 && std::strcmp(argv[1], "--check-simd") == 0) return regression::RunSimdCheck() == 0 ? 0 : 1;
+
+    // --stream <frames> writes the spinning cube to stdout as Y4M, e.g. piped into ffmpeg -i - or ffplay -
+    if(argc == 3 && std::strcmp(argv[1], "--stream") == 0) {
+        graphics::FrameBuffer frame(world::WIDTH, world::HEIGHT);
+        io::VideoStream stream(io::GetBinaryStdout(), world::WIDTH, world::HEIGHT, 60);
+
+        const long frames = std::strtol(argv[2], nullptr, 10);
+        for(long i = 0; i < frames; ++i) {
+            TRACE_SCOPE("Frame");
+
+            shader::Default shader{world::GetMVP(0.02f * static_cast<float>(i + 1)),
+                                   math::CreateViewport(static_cast<float>(world::WIDTH),
+                                                        static_cast<float>(world::HEIGHT))};
+            frame.Clear(world::COLOR);
+            graphics::Render(frame, shader, world::ModelVertices, world::ModelIndices);
+
+            if(!stream.Submit(frame.GetColor())) break;
+        }
+
+#ifdef ENGINE_TRACE
+        core::ExportTrace("trace.json");
+#endif
+        return stream.Finish() ? 0 : 1;
+    }
+
+    // --batch <views> renders the cube from that many orbiting cameras as 160x90 thumbnails and reports the rate
+    if(argc == 3 && std::strcmp(argv[1], "--batch") == 0) {
+        core::JobSystem& jobs = core::GetJobSystem();
+        graphics::BatchRenderer batch(jobs, 160, 90);
+        batch.SetScene({{&world::ModelVertices, &world::ModelIndices, math::Matrix{}}});
+
+        const math::Matrix proj = math::CreatePerspective(math::ToRadian(45.f), 160.f / 90.f, 0.1f, 100.f);
+        std::vector<math::Matrix> cameras(std::strtoul(argv[2], nullptr, 10));
+        for(std::size_t i = 0; i < cameras.size(); ++i) {
+            const float angle = math::ToRadian(360.f) * static_cast<float>(i) / static_cast<float>(cameras.size());
+            cameras[i] = proj * math::CreateLookAt({5.f * std::sin(angle), 2.f, 5.f * std::cos(angle)},
+                                                   {0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+        }
+
+        const graphics::BatchStats stats =
+            batch.Render(cameras, world::COLOR, [](std::size_t, const graphics::FrameBuffer&) {});
+        std::printf("%zu views in %.3f s, %.1f frames/s on %zu workers\n", stats.Views, stats.Seconds,
+                    stats.FramesPerSecond, jobs.GetWorkerCount());
+        return 0;
+    }
+
+    // --optimize-mesh reorders the cube, a UV sphere and four nested spheres and prints their cache and overdraw
+    // figures; the convex meshes have no overdraw to remove, the nested spheres drawn inside out do
+    if(argc == 2 && std::strcmp(argv[1], "--optimize-mesh") == 0) {
+        mesh::Mesh meshes[3] = {{world::ModelVertices, world::ModelIndices}, mesh::CreateSphere(64, 32),
+                                mesh::CreateNestedSpheres(4, 64, 32)};
+        const char* names[3] = {"cube", "sphere", "nested"};
+
+        for(int i = 0; i < 3; ++i) {
+            const mesh::OptimizeReport report = mesh::OptimizeMesh(meshes[i].Vertices, meshes[i].Indices);
+            std::printf("%-7s ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  overdraw %.3f -> %.3f\n", names[i],
+                        report.Before.Cache.ACMR, report.After.Cache.ACMR, report.Before.Cache.ATVR,
+                        report.After.Cache.ATVR, report.Before.Overdraw, report.After.Overdraw);
+        }
+        return 0;
+    }
+
+    // --lod builds an LOD chain for a dense sphere and prints the level picked as the camera backs away from it
+    if(argc == 2 && std::strcmp(argv[1], "--lod") == 0) {
+        const mesh::LodChain chain = mesh::BuildLodChain(mesh::CreateSphere(128, 64));
+        for(std::size_t i = 0; i < chain.Levels.size(); ++i) {
+            std::printf("level %zu: %6zu triangles, error %.5f\n", i, chain.Levels[i].Geometry.Indices.size() / 3,
+                        chain.Levels[i].Error);
+        }
+
+        const math::Matrix proj = math::CreatePerspective(
+            math::ToRadian(45.f), static_cast<float>(world::WIDTH) / static_cast<float>(world::HEIGHT), 0.1f, 100.f);
+        mesh::LodSelector selector;
+
+        for(float distance = 1.5f; distance <= 48.f; distance *= 2.f) {
+            const math::Matrix view = math::CreateLookAt({0.f, 0.f, distance}, {0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+            std::printf("distance %5.1f: level %zu\n", distance, selector.Select(chain, view, proj, world::HEIGHT));
+        }
+        return 0;
+    }
+
+    // --render <width> <height> <path> writes the cube as a PPM of any size, e.g. 16384 16384, one band of rows at a
+    // time so only a band's color and depth are ever held in memory
+    if(argc == 5 && std::strcmp(argv[1], "--render") == 0) {
+        const std::uint32_t width = static_cast<std::uint32_t>(std::strtoul(argv[2], nullptr, 10));
+        const std::uint32_t height = static_cast<std::uint32_t>(std::strtoul(argv[3], nullptr, 10));
+        if(width == 0 || height == 0) return 1;
+
+        const float aspect = static_cast<float>(width) / static_cast<float>(height);
+        const math::Matrix view = math::CreateLookAt({0.f, 0.f, 5.f}, {0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+        const shader::Default shader{
+            math::CreatePerspective(math::ToRadian(45.f), aspect, 0.1f, 100.f) * view *
+                math::CreateRotation({0.f, 1.f, 0.f}, 0.5f),
+            math::CreateViewport(static_cast<float>(width), static_cast<float>(height))};
+
+        graphics::BandRenderer bands(width, height);
+        io::ImageWriter image(argv[4], width, height);
+
+        const bool written =
+            bands.Render(
+                world::COLOR,
+                [&](graphics::FrameBuffer& frame) {
+                    graphics::Render(frame, shader, world::ModelVertices, world::ModelIndices);
+                },
+                [&](std::uint32_t, const std::uint32_t rows, const std::uint32_t* colors) {
+                    return image.WriteRows(colors, rows);
+                }) &&
+            image.Close();
+
+        std::printf("%ux%u in %u bands of %u rows: %s\n", width, height, bands.GetBandCount(), bands.GetBandHeight(),
+                    written ? "written" : "failed");
+        return written ? 0 : 1;
+    }
+
     glfwSetErrorCallback(ErrCallback);
 
     if(!glfwInit()) return -1;
@@ -25,25 +174,79 @@ int main() {
     glfwMakeContextCurrent(window);
 
     graphics::FrameBuffer frame(world::WIDTH, world::HEIGHT);
+    core::JobSystem& jobs = core::GetJobSystem();
+    graphics::RenderContext context(jobs.GetWorkerCount());
     float angle = 0.0f;
 
+    // Only the area the cube covered last frame and covers now is cleared and redrawn
+    graphics::DirtyRegion dirty(world::WIDTH, world::HEIGHT);
+    graphics::BoundingBox cubeBound = {0, -1, 0, -1, false};
+    dirty.AddAll();
+
+    graphics::BinnedDraw<> cube(world::ModelVertices, world::ModelIndices, world::HEIGHT);
+    const graphics::BoundingBox screen = graphics::GetFullRect(world::WIDTH, world::HEIGHT);
+
+    // Bands clear while the cube is transformed and binned; a band rasterizes once it is both clear and binned,
+    // and presenting waits for every band. The cube is opaque and single-sampled, so there is no resolve stage: a
+    // transparent or multisampled draw would resolve each band between Raster and Present
+    core::TaskGraph graph;
+    const core::TaskId vertex =
+        graph.Add("Vertex", [&](const std::size_t worker) { cube.Transform(context.GetArena(worker)); });
+    const core::TaskId bin = graph.Add(
+        "SetupBin", [&](const std::size_t worker) { cube.Bin(context.GetArena(worker), screen); }, {vertex});
+
+    std::vector<core::TaskId> bands;
+    for(int band = 0; band < cube.GetBandCount(); ++band) {
+        const core::TaskId clear = graph.Add("Clear", [&, band](std::size_t) {
+            for(const graphics::BoundingBox& rect : dirty.GetRects()) {
+                frame.Clear(cube.GetBand(band, rect), world::COLOR);
+            }
+        });
+
+        bands.push_back(graph.Add(
+            "Raster",
+            [&, band](std::size_t) {
+                for(const graphics::BoundingBox& rect : dirty.GetRects()) cube.Rasterize(frame, band, rect);
+            },
+            {clear, bin}));
+    }
+
+    const core::TaskId present = graph.Add(
+        "Present",
+        [&](std::size_t) {
+            glRasterPos2f(-1, 1);
+            glPixelZoom(1, -1);
+            glDrawPixels(world::WIDTH, world::HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, frame.GetColor());
+
+            glfwSwapBuffers(window);
+        },
+        {}, true);
+    for(const core::TaskId band : bands) graph.Depend(present, band);
+
     while(!glfwWindowShouldClose(window)) {
-        frame.Clear(world::COLOR);
+        TRACE_SCOPE("Frame");
 
         angle += 0.02f;
         shader::Default shader{world::GetMVP(angle), math::CreateViewport(static_cast<float>(world::WIDTH),
                                                                           static_cast<float>(world::HEIGHT))};
 
-        graphics::Render(frame, shader, world::ModelVertices, world::ModelIndices, graphics::PrimitiveType::Triangles);
+        const graphics::BoundingBox bound =
+            graphics::GetScreenBound(shader, world::ModelVertices, world::WIDTH, world::HEIGHT);
+        dirty.Add(cubeBound, bound);
+        cubeBound = bound;
 
-        glRasterPos2f(-1, 1);
-        glPixelZoom(1, -1);
-        glDrawPixels(world::WIDTH, world::HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, frame.GetColor());
+        cube.SetShader(shader);
+        jobs.Execute(graph);
 
-        glfwSwapBuffers(window);
+        dirty.Reset();
+        context.EndFrame();
         glfwPollEvents();
     }
 
+#ifdef ENGINE_TRACE
+    core::ExportTrace("trace.json");
+#endif
+
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,442 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "SIMD.hpp"
+#include "Vector.hpp"
+
+// Lane types wider than the build baseline only pass between functions that all get flattened into one target
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace math {
+    constexpr inline std::size_t BATCH_LANES = 16;
+
+    // Blocked structure-of-arrays: every block stores BATCH_LANES elements component by component, so a kernel
+    // reads one sequential stream while still loading whole registers of a single component
+    template <typename Element, std::size_t Components> struct Batch {
+        std::vector<float> Data;
+
+        Batch() = default;
+
+        explicit Batch(const std::size_t count) { Resize(count); }
+
+        inline std::size_t Size() const noexcept { return count; }
+        inline std::size_t GetBlockCount() const noexcept { return (count + BATCH_LANES - 1) / BATCH_LANES; }
+
+        inline void Resize(const std::size_t newCount) {
+            count = newCount;
+            Data.resize(GetBlockCount() * Components * BATCH_LANES);
+        }
+
+        inline float* GetBlock(const std::size_t block) noexcept {
+            return Data.data() + block * Components * BATCH_LANES;
+        }
+
+        inline const float* GetBlock(const std::size_t block) const noexcept {
+            return Data.data() + block * Components * BATCH_LANES;
+        }
+
+        inline Element Get(const std::size_t index) const noexcept {
+            Element element;
+            float* components = reinterpret_cast<float*>(&element);
+            const float* src = GetBlock(index / BATCH_LANES) + index % BATCH_LANES;
+
+            for(std::size_t i = 0; i < Components; ++i) components[i] = src[i * BATCH_LANES];
+            return element;
+        }
+
+        inline void Set(const std::size_t index, const Element& element) noexcept {
+            const float* components = reinterpret_cast<const float*>(&element);
+            float* dst = GetBlock(index / BATCH_LANES) + index % BATCH_LANES;
+
+            for(std::size_t i = 0; i < Components; ++i) dst[i * BATCH_LANES] = components[i];
+        }
+
+    private:
+        std::size_t count = 0;
+    };
+
+    using Vectors = Batch<Vector, 4>;
+    using Quaternions = Batch<Quaternion, 4>;
+    using Matrices = Batch<Matrix, 16>;
+
+    struct PortableLanes {
+        using Type = simd::Floats8;
+        static constexpr std::size_t Width = 8;
+
+        static inline Type Load(const float* src) noexcept { return simd::Load8(src); }
+        static inline void Store(float* dst, const Type& val) noexcept { simd::Store(dst, val); }
+        static inline Type Set(const float val) noexcept { return simd::Set8(val); }
+        static inline Type Add(const Type& lhs, const Type& rhs) noexcept { return simd::Add(lhs, rhs); }
+        static inline Type Sub(const Type& lhs, const Type& rhs) noexcept { return simd::Sub(lhs, rhs); }
+        static inline Type Mul(const Type& lhs, const Type& rhs) noexcept { return simd::Mul(lhs, rhs); }
+        static inline Type Div(const Type& lhs, const Type& rhs) noexcept { return simd::Div(lhs, rhs); }
+        static inline Type Sqrt(const Type& val) noexcept { return simd::Sqrt(val); }
+        static inline Type And(const Type& lhs, const Type& rhs) noexcept { return simd::And(lhs, rhs); }
+        static inline Type Xor(const Type& lhs, const Type& rhs) noexcept { return simd::Xor(lhs, rhs); }
+
+        // Lane i reads base[offsets[i]]
+        static inline Type Gather(const float* base, const std::int32_t* offsets) noexcept {
+            float values[Width];
+            for(std::size_t i = 0; i < Width; ++i) values[i] = base[offsets[i]];
+            return simd::Load8(values);
+        }
+    };
+
+#ifdef ENGINE_SIMD_SSE
+    struct AVX2Lanes {
+        using Type = __m256;
+        static constexpr std::size_t Width = 8;
+
+        ENGINE_SIMD_TARGET("avx2") static inline Type Load(const float* src) noexcept { return _mm256_loadu_ps(src); }
+        ENGINE_SIMD_TARGET("avx2") static inline void Store(float* dst, const Type& val) noexcept {
+            _mm256_storeu_ps(dst, val);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Set(const float val) noexcept { return _mm256_set1_ps(val); }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Add(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_add_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Sub(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_sub_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Mul(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_mul_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Div(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_div_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Sqrt(const Type& val) noexcept { return _mm256_sqrt_ps(val); }
+        ENGINE_SIMD_TARGET("avx2") static inline Type And(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_and_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Xor(const Type& lhs, const Type& rhs) noexcept {
+            return _mm256_xor_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx2") static inline Type Gather(const float* base, const std::int32_t* offsets) noexcept {
+            return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets)), 4);
+        }
+    };
+
+    struct AVX512Lanes {
+        using Type = __m512;
+        static constexpr std::size_t Width = 16;
+
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Load(const float* src) noexcept {
+            return _mm512_loadu_ps(src);
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline void Store(float* dst, const Type& val) noexcept {
+            _mm512_storeu_ps(dst, val);
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Set(const float val) noexcept { return _mm512_set1_ps(val); }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Add(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_add_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Sub(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_sub_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Mul(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_mul_ps(lhs, rhs);
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Div(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_div_ps(lhs, rhs);
+        }
+        // The zero-masked form, since GCC flags the undefined source of _mm512_sqrt_ps as uninitialized
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Sqrt(const Type& val) noexcept {
+            return _mm512_maskz_sqrt_ps(0xFFFF, val);
+        }
+        // Float logic ops are AVX512DQ, the integer forms only need AVX512F
+        ENGINE_SIMD_TARGET("avx512f") static inline Type And(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(lhs), _mm512_castps_si512(rhs)));
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Xor(const Type& lhs, const Type& rhs) noexcept {
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(lhs), _mm512_castps_si512(rhs)));
+        }
+        ENGINE_SIMD_TARGET("avx512f") static inline Type Gather(const float* base,
+                                                                const std::int32_t* offsets) noexcept {
+            return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, _mm512_loadu_si512(offsets), base, 4);
+        }
+    };
+
+    // Whole kernels are compiled for the wider instruction set so the lane operations inline into them
+    template <typename Kernel> ENGINE_SIMD_TARGET("avx2") inline void RunAVX2(Kernel& kernel) {
+        kernel(AVX2Lanes{});
+    }
+
+    template <typename Kernel> ENGINE_SIMD_TARGET("avx512f") inline void RunAVX512(Kernel& kernel) {
+        kernel(AVX512Lanes{});
+    }
+#endif
+
+    // Runs kernel(lanes) with the widest lanes the running CPU supports
+    template <typename Kernel> inline void Dispatch(Kernel&& kernel) {
+#ifdef ENGINE_SIMD_SSE
+        const simd::Features& features = simd::GetFeatures();
+        if(features.AVX512) return RunAVX512(kernel);
+        if(features.AVX2) return RunAVX2(kernel);
+#endif
+        kernel(PortableLanes{});
+    }
+
+    // Kernels walk every block, Lanes::Width elements per step; padding lanes of the last block are computed too
+    template <typename Lanes> inline void TransformKernel(const Matrix& mat, const Vectors& in, Vectors& out) noexcept {
+        typename Lanes::Type m[4][4];
+        for(int col = 0; col < 4; ++col) {
+            for(int row = 0; row < 4; ++row) m[col][row] = Lanes::Set(mat[col][row]);
+        }
+
+        for(std::size_t block = 0; block < in.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* src = in.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                const typename Lanes::Type x = Lanes::Load(src);
+                const typename Lanes::Type y = Lanes::Load(src + BATCH_LANES);
+                const typename Lanes::Type z = Lanes::Load(src + BATCH_LANES * 2);
+                const typename Lanes::Type w = Lanes::Load(src + BATCH_LANES * 3);
+
+                for(int row = 0; row < 4; ++row) {
+                    typename Lanes::Type res = Lanes::Mul(m[0][row], x);
+                    res = Lanes::Add(res, Lanes::Mul(m[1][row], y));
+                    res = Lanes::Add(res, Lanes::Mul(m[2][row], z));
+                    res = Lanes::Add(res, Lanes::Mul(m[3][row], w));
+                    Lanes::Store(dst + BATCH_LANES * row, res);
+                }
+            }
+        }
+    }
+
+    template <typename Lanes>
+    inline void MultiplyKernel(const Matrices& lhs, const Matrices& rhs, Matrices& out) noexcept {
+        for(std::size_t block = 0; block < lhs.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* left = lhs.GetBlock(block) + lane;
+                const float* right = rhs.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                typename Lanes::Type l[16];
+                for(int i = 0; i < 16; ++i) l[i] = Lanes::Load(left + BATCH_LANES * i);
+
+                for(int col = 0; col < 4; ++col) {
+                    const typename Lanes::Type r0 = Lanes::Load(right + BATCH_LANES * (col * 4 + 0));
+                    const typename Lanes::Type r1 = Lanes::Load(right + BATCH_LANES * (col * 4 + 1));
+                    const typename Lanes::Type r2 = Lanes::Load(right + BATCH_LANES * (col * 4 + 2));
+                    const typename Lanes::Type r3 = Lanes::Load(right + BATCH_LANES * (col * 4 + 3));
+
+                    for(int row = 0; row < 4; ++row) {
+                        typename Lanes::Type res = Lanes::Mul(l[row], r0);
+                        res = Lanes::Add(res, Lanes::Mul(l[4 + row], r1));
+                        res = Lanes::Add(res, Lanes::Mul(l[8 + row], r2));
+                        res = Lanes::Add(res, Lanes::Mul(l[12 + row], r3));
+                        Lanes::Store(dst + BATCH_LANES * (col * 4 + row), res);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Lanes> inline void NormalizeKernel(const Vectors& in, Vectors& out) noexcept {
+        const typename Lanes::Type one = Lanes::Set(1.f);
+
+        for(std::size_t block = 0; block < in.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* src = in.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                const typename Lanes::Type x = Lanes::Load(src);
+                const typename Lanes::Type y = Lanes::Load(src + BATCH_LANES);
+                const typename Lanes::Type z = Lanes::Load(src + BATCH_LANES * 2);
+                const typename Lanes::Type w = Lanes::Load(src + BATCH_LANES * 3);
+
+                typename Lanes::Type dot = Lanes::Mul(x, x);
+                dot = Lanes::Add(dot, Lanes::Mul(y, y));
+                dot = Lanes::Add(dot, Lanes::Mul(z, z));
+
+                const typename Lanes::Type inv = Lanes::Div(one, Lanes::Sqrt(dot));
+
+                Lanes::Store(dst, Lanes::Mul(x, inv));
+                Lanes::Store(dst + BATCH_LANES, Lanes::Mul(y, inv));
+                Lanes::Store(dst + BATCH_LANES * 2, Lanes::Mul(z, inv));
+                Lanes::Store(dst + BATCH_LANES * 3, Lanes::Mul(w, inv));
+            }
+        }
+    }
+
+    // translations may be null, leaving the rotation matrices without a translation column
+    template <typename Lanes>
+    inline void ToMatrixKernel(const Quaternions& in, const Vectors* translations, Matrices& out) noexcept {
+        const typename Lanes::Type zero = Lanes::Set(0.f);
+        const typename Lanes::Type one = Lanes::Set(1.f);
+        const typename Lanes::Type two = Lanes::Set(2.f);
+
+        for(std::size_t block = 0; block < in.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* src = in.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                const typename Lanes::Type x = Lanes::Load(src);
+                const typename Lanes::Type y = Lanes::Load(src + BATCH_LANES);
+                const typename Lanes::Type z = Lanes::Load(src + BATCH_LANES * 2);
+                const typename Lanes::Type w = Lanes::Load(src + BATCH_LANES * 3);
+
+                const typename Lanes::Type xx2 = Lanes::Mul(Lanes::Mul(x, x), two);
+                const typename Lanes::Type yy2 = Lanes::Mul(Lanes::Mul(y, y), two);
+                const typename Lanes::Type zz2 = Lanes::Mul(Lanes::Mul(z, z), two);
+                const typename Lanes::Type xy2 = Lanes::Mul(Lanes::Mul(x, y), two);
+                const typename Lanes::Type xz2 = Lanes::Mul(Lanes::Mul(x, z), two);
+                const typename Lanes::Type yz2 = Lanes::Mul(Lanes::Mul(y, z), two);
+                const typename Lanes::Type wx2 = Lanes::Mul(Lanes::Mul(w, x), two);
+                const typename Lanes::Type wy2 = Lanes::Mul(Lanes::Mul(w, y), two);
+                const typename Lanes::Type wz2 = Lanes::Mul(Lanes::Mul(w, z), two);
+
+                const typename Lanes::Type elements[16] = {
+                    Lanes::Sub(Lanes::Sub(one, yy2), zz2), Lanes::Add(xy2, wz2), Lanes::Sub(xz2, wy2), zero,
+                    Lanes::Sub(xy2, wz2), Lanes::Sub(Lanes::Sub(one, xx2), zz2), Lanes::Add(yz2, wx2), zero,
+                    Lanes::Add(xz2, wy2), Lanes::Sub(yz2, wx2), Lanes::Sub(Lanes::Sub(one, xx2), yy2), zero,
+                    zero, zero, zero, one};
+
+                for(int i = 0; i < 16; ++i) Lanes::Store(dst + BATCH_LANES * i, elements[i]);
+
+                if(translations != nullptr) {
+                    const float* offset = translations->GetBlock(block) + lane;
+                    for(int i = 0; i < 3; ++i) {
+                        Lanes::Store(dst + BATCH_LANES * (12 + i), Lanes::Load(offset + BATCH_LANES * i));
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Lanes>
+    inline void LerpKernel(const Vectors& from, const Vectors& to, const float t, Vectors& out) noexcept {
+        const typename Lanes::Type weight = Lanes::Set(t);
+
+        for(std::size_t block = 0; block < from.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* a = from.GetBlock(block) + lane;
+                const float* b = to.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                for(int i = 0; i < 4; ++i) {
+                    const typename Lanes::Type start = Lanes::Load(a + BATCH_LANES * i);
+                    const typename Lanes::Type end = Lanes::Load(b + BATCH_LANES * i);
+                    Lanes::Store(dst + BATCH_LANES * i, Lanes::Add(start, Lanes::Mul(Lanes::Sub(end, start), weight)));
+                }
+            }
+        }
+    }
+
+    // Normalized lerp along the shorter arc. Corrected reshapes t with a cubic fitted to slerp (Kapoulkine's
+    // approximation), which stays within about 1e-3 radians of slerp without any trigonometry
+    template <typename Lanes, bool Corrected>
+    inline void NlerpKernel(const Quaternions& from, const Quaternions& to, const float t, Quaternions& out) noexcept {
+        const typename Lanes::Type signMask = Lanes::Set(-0.f);
+        const typename Lanes::Type one = Lanes::Set(1.f);
+        const typename Lanes::Type weight = Lanes::Set(t);
+        const typename Lanes::Type centered = Lanes::Set((t - 0.5f) * (t - 0.5f));
+        const typename Lanes::Type cubic = Lanes::Set(t * (t - 0.5f) * (t - 1.f));
+
+        for(std::size_t block = 0; block < from.GetBlockCount(); ++block) {
+            for(std::size_t lane = 0; lane < BATCH_LANES; lane += Lanes::Width) {
+                const float* a = from.GetBlock(block) + lane;
+                const float* b = to.GetBlock(block) + lane;
+                float* dst = out.GetBlock(block) + lane;
+
+                typename Lanes::Type start[4];
+                typename Lanes::Type end[4];
+                for(int i = 0; i < 4; ++i) {
+                    start[i] = Lanes::Load(a + BATCH_LANES * i);
+                    end[i] = Lanes::Load(b + BATCH_LANES * i);
+                }
+
+                typename Lanes::Type dot = Lanes::Mul(start[0], end[0]);
+                for(int i = 1; i < 4; ++i) dot = Lanes::Add(dot, Lanes::Mul(start[i], end[i]));
+
+                const typename Lanes::Type flip = Lanes::And(dot, signMask);
+                for(int i = 0; i < 4; ++i) end[i] = Lanes::Xor(end[i], flip);
+
+                typename Lanes::Type blend = weight;
+                if constexpr(Corrected) {
+                    const typename Lanes::Type d = Lanes::Xor(dot, flip);
+                    typename Lanes::Type a3 = Lanes::Sub(Lanes::Set(3.55645f), Lanes::Mul(d, Lanes::Set(1.43519f)));
+                    a3 = Lanes::Add(Lanes::Set(-3.2452f), Lanes::Mul(d, a3));
+                    a3 = Lanes::Add(Lanes::Set(1.0904f), Lanes::Mul(d, a3));
+
+                    typename Lanes::Type b2 = Lanes::Add(Lanes::Set(-1.06021f), Lanes::Mul(d, Lanes::Set(0.215638f)));
+                    b2 = Lanes::Add(Lanes::Set(0.848013f), Lanes::Mul(d, b2));
+
+                    const typename Lanes::Type k = Lanes::Add(Lanes::Mul(a3, centered), b2);
+                    blend = Lanes::Add(weight, Lanes::Mul(cubic, k));
+                }
+
+                typename Lanes::Type res[4];
+                typename Lanes::Type length = Lanes::Set(0.f);
+                for(int i = 0; i < 4; ++i) {
+                    res[i] = Lanes::Add(start[i], Lanes::Mul(Lanes::Sub(end[i], start[i]), blend));
+                    length = Lanes::Add(length, Lanes::Mul(res[i], res[i]));
+                }
+
+                const typename Lanes::Type inv = Lanes::Div(one, Lanes::Sqrt(length));
+                for(int i = 0; i < 4; ++i) Lanes::Store(dst + BATCH_LANES * i, Lanes::Mul(res[i], inv));
+            }
+        }
+    }
+
+    // out[i] = mat * in[i]
+    inline void TransformVectors(const Matrix& mat, const Vectors& in, Vectors& out) {
+        out.Resize(in.Size());
+        Dispatch([&](auto lanes) { TransformKernel<decltype(lanes)>(mat, in, out); });
+    }
+
+    // out[i] = lhs[i] * rhs[i]
+    inline void MultiplyMatrices(const Matrices& lhs, const Matrices& rhs, Matrices& out) {
+        out.Resize(lhs.Size());
+        Dispatch([&](auto lanes) { MultiplyKernel<decltype(lanes)>(lhs, rhs, out); });
+    }
+
+    // out[i] = in[i].Norm()
+    inline void NormalizeVectors(const Vectors& in, Vectors& out) {
+        out.Resize(in.Size());
+        Dispatch([&](auto lanes) { NormalizeKernel<decltype(lanes)>(in, out); });
+    }
+
+    // out[i] = in[i].ToMatrix()
+    inline void QuaternionsToMatrices(const Quaternions& in, Matrices& out) {
+        out.Resize(in.Size());
+        Dispatch([&](auto lanes) { ToMatrixKernel<decltype(lanes)>(in, nullptr, out); });
+    }
+
+    // out[i] = translations[i] applied after rotations[i]
+    inline void ComposeTransforms(const Quaternions& rotations, const Vectors& translations, Matrices& out) {
+        out.Resize(rotations.Size());
+        Dispatch([&](auto lanes) { ToMatrixKernel<decltype(lanes)>(rotations, &translations, out); });
+    }
+
+    // out[i] = from[i] + (to[i] - from[i]) * t
+    inline void LerpVectors(const Vectors& from, const Vectors& to, const float t, Vectors& out) {
+        out.Resize(from.Size());
+        Dispatch([&](auto lanes) { LerpKernel<decltype(lanes)>(from, to, t, out); });
+    }
+
+    // out[i] = nlerp(from[i], to[i], t)
+    inline void NlerpQuaternions(const Quaternions& from, const Quaternions& to, const float t, Quaternions& out) {
+        out.Resize(from.Size());
+        Dispatch([&](auto lanes) { NlerpKernel<decltype(lanes), false>(from, to, t, out); });
+    }
+
+    // out[i] ~= from[i].Slerp(to[i], t)
+    inline void SlerpQuaternions(const Quaternions& from, const Quaternions& to, const float t, Quaternions& out) {
+        out.Resize(from.Size());
+        Dispatch([&](auto lanes) { NlerpKernel<decltype(lanes), true>(from, to, t, out); });
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <numbers>
 
+#include "Batch.hpp"
 #include "Matrix.hpp"
 #include "Quaternion.hpp"
 #include "SIMD.hpp"
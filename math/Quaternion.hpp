@@ -96,7 +96,7 @@ namespace math {
         Quaternion Reciprocal() const noexcept { return Quaternion(simd::Reciprocal(Q)); }
         Quaternion Sqrt() const noexcept { return Quaternion(simd::Sqrt(Q)); }
 
-        float Dot(const Quaternion& other) const noexcept { return simd::GetFirst(simd::HorizonSum<0x71>(Q, other.Q)); }
+        float Dot(const Quaternion& other) const noexcept { return simd::GetFirst(simd::HorizonSum<0xF1>(Q, other.Q)); }
 
         Quaternion& operator*=(const Quaternion& other) noexcept {
             Q = simd::Set(W * other.X + X * other.W + Y * other.Z - Z * other.Y,
@@ -144,7 +144,7 @@ namespace math {
         }
 
         Quaternion Slerp(const Quaternion& other, const float t) const noexcept {
-            float cosHalfTheta = simd::GetFirst(simd::HorizonSum<0x71>(Q, other.Q));
+            float cosHalfTheta = Dot(other);
 
             Quaternion target = other;
             if(cosHalfTheta < 0.f) {
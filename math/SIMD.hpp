@@ -1,24 +1,80 @@
 ﻿#pragma once
 
+#include <array>
+#include <bit>
+#include <cmath>
 #include <cstdint>
-#include <xmmintrin.h>
 
-namespace simd {
+#if defined(ENGINE_SIMD_FORCE_SCALAR)
+#define ENGINE_SIMD_SCALAR
 
-#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
 #include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 #define ENGINE_SIMD_SSE
-
-    typedef __m128 Floats;
+// SSE4.1 is a build-time choice: Round and HorizonSum are too small to pay for a runtime feature check
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define ENGINE_SIMD_SSE41
+#endif
+#ifdef __AVX__
+#define ENGINE_SIMD_AVX
+#endif
 
 #elif defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM64)
 #include <arm_neon.h>
 #define ENGINE_SIMD_NEON
 
-    typedef float32x4_t Floats;
+#else
+#define ENGINE_SIMD_SCALAR
+#endif
+
+#ifndef _MM_SHUFFLE
+#define _MM_SHUFFLE(z, y, x, w) (((z) << 6) | ((y) << 4) | ((x) << 2) | (w))
+#endif
 
+// Functions compiled for an instruction set above the build baseline, only called after checking GetFeatures()
+#if defined(ENGINE_SIMD_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define ENGINE_SIMD_TARGET(isa) __attribute__((target(isa), flatten))
 #else
-#error "UNDEFINED ARCHITEXTURE"
+#define ENGINE_SIMD_TARGET(isa)
+#endif
+
+namespace simd {
+#ifdef ENGINE_SIMD_SSE
+    typedef __m128 Floats;
+#elif defined(ENGINE_SIMD_NEON)
+    typedef float32x4_t Floats;
+#else
+    struct alignas(16) Floats {
+        float V[4];
+    };
+#endif
+
+    // All-ones in lane i when bit i of BITS is set
+    template <unsigned BITS> constexpr std::array<std::uint32_t, 4> GetLaneMask() noexcept {
+        return {BITS & 1u ? ~0u : 0u, BITS & 2u ? ~0u : 0u, BITS & 4u ? ~0u : 0u, BITS & 8u ? ~0u : 0u};
+    }
+
+#ifdef ENGINE_SIMD_NEON
+    // vqtbl byte indices for an _MM_SHUFFLE mask; lanes 2 and 3 read UPPER bytes further into the table
+    template <std::uint8_t MASK, std::uint8_t UPPER> constexpr std::array<std::uint8_t, 16> GetShuffleTable() noexcept {
+        std::array<std::uint8_t, 16> table{};
+        for(int lane = 0; lane < 4; ++lane) {
+            const int source = ((MASK >> (lane * 2)) & 3) * 4 + (lane >= 2 ? UPPER : 0);
+            for(int byte = 0; byte < 4; ++byte) table[lane * 4 + byte] = static_cast<std::uint8_t>(source + byte);
+        }
+        return table;
+    }
+#endif
+
+#ifdef ENGINE_SIMD_SCALAR
+    inline float ToFloat(const std::uint32_t bits) noexcept { return std::bit_cast<float>(bits); }
+    inline std::uint32_t ToBits(const float val) noexcept { return std::bit_cast<std::uint32_t>(val); }
+    inline float ToMask(const bool condition) noexcept { return ToFloat(condition ? ~0u : 0u); }
 #endif
 
     // Arithmetics
@@ -26,6 +82,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_add_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vaddq_f32(lhs, rhs);
+#else
+        return {{lhs.V[0] + rhs.V[0], lhs.V[1] + rhs.V[1], lhs.V[2] + rhs.V[2], lhs.V[3] + rhs.V[3]}};
 #endif
     }
 
@@ -33,6 +92,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_sub_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vsubq_f32(lhs, rhs);
+#else
+        return {{lhs.V[0] - rhs.V[0], lhs.V[1] - rhs.V[1], lhs.V[2] - rhs.V[2], lhs.V[3] - rhs.V[3]}};
 #endif
     }
 
@@ -40,6 +102,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_mul_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vmulq_f32(lhs, rhs);
+#else
+        return {{lhs.V[0] * rhs.V[0], lhs.V[1] * rhs.V[1], lhs.V[2] * rhs.V[2], lhs.V[3] * rhs.V[3]}};
 #endif
     }
 
@@ -47,13 +112,21 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_div_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vdivq_f32(lhs, rhs);
+#else
+        return {{lhs.V[0] / rhs.V[0], lhs.V[1] / rhs.V[1], lhs.V[2] / rhs.V[2], lhs.V[3] / rhs.V[3]}};
 #endif
     }
 
+    // Approximate; NEON refines its 8-bit estimate with one Newton step to come close to SSE's 12 bits
     inline Floats Reciprocal(const Floats& val) noexcept {
 #ifdef ENGINE_SIMD_SSE
         return _mm_rcp_ps(val);
 #elif defined(ENGINE_SIMD_NEON)
+        const float32x4_t estimate = vrecpeq_f32(val);
+        return vmulq_f32(estimate, vrecpsq_f32(val, estimate));
+#else
+        return {{1.f / val.V[0], 1.f / val.V[1], 1.f / val.V[2], 1.f / val.V[3]}};
 #endif
     }
 
@@ -61,13 +134,62 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_sqrt_ps(val);
 #elif defined(ENGINE_SIMD_NEON)
+        return vsqrtq_f32(val);
+#else
+        return {{std::sqrt(val.V[0]), std::sqrt(val.V[1]), std::sqrt(val.V[2]), std::sqrt(val.V[3])}};
 #endif
     }
 
-    template <std::uint8_t MASK> inline Floats HorizonSum(const Floats& lhs, const Floats& rhs) noexcept {
+    // Rounds half away from zero, matching std::round
+    inline Floats Round(const Floats& val) noexcept {
 #ifdef ENGINE_SIMD_SSE
+        const Floats signMask = _mm_set1_ps(-0.0f);
+#ifdef ENGINE_SIMD_SSE41
+        const Floats truncated = _mm_round_ps(val, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+#else
+        // Magnitudes from 2^23 up are already integral and may not fit the int32 conversion
+        const Floats isIntegral = _mm_cmpge_ps(_mm_andnot_ps(signMask, val), _mm_set1_ps(8388608.f));
+        const Floats converted = _mm_cvtepi32_ps(_mm_cvttps_epi32(val));
+        const Floats truncated = _mm_or_ps(_mm_and_ps(isIntegral, val), _mm_andnot_ps(isIntegral, converted));
+#endif
+        const Floats fraction = _mm_andnot_ps(signMask, _mm_sub_ps(val, truncated));
+        const Floats sign = _mm_and_ps(val, signMask);
+        const Floats step = _mm_or_ps(sign, _mm_set1_ps(1.f));
+        // The sign goes back on so that -0.3 rounds to -0 as with std::round, not to the +0 the addition leaves
+        return _mm_or_ps(_mm_add_ps(truncated, _mm_and_ps(step, _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)))), sign);
+#elif defined(ENGINE_SIMD_NEON)
+        return vrndaq_f32(val);
+#else
+        return {{std::round(val.V[0]), std::round(val.V[1]), std::round(val.V[2]), std::round(val.V[3])}};
+#endif
+    }
+
+    // Dot product with _mm_dp_ps semantics: the high nibble of MASK picks the products, the low nibble the outputs
+    template <std::uint8_t MASK> inline Floats HorizonSum(const Floats& lhs, const Floats& rhs) noexcept {
+#ifdef ENGINE_SIMD_SSE41
         return _mm_dp_ps(lhs, rhs, MASK);
+#else
+        static constexpr std::array<std::uint32_t, 4> inputs = GetLaneMask<(MASK >> 4) & 0xF>();
+        static constexpr std::array<std::uint32_t, 4> outputs = GetLaneMask<MASK & 0xF>();
+#ifdef ENGINE_SIMD_SSE
+        const Floats inputMask = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputs.data())));
+        const Floats outputMask = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(outputs.data())));
+
+        const Floats products = _mm_and_ps(_mm_mul_ps(lhs, rhs), inputMask);
+        Floats sum = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_and_ps(sum, outputMask);
 #elif defined(ENGINE_SIMD_NEON)
+        const uint32x4_t products = vandq_u32(vreinterpretq_u32_f32(vmulq_f32(lhs, rhs)), vld1q_u32(inputs.data()));
+        const float32x4_t sum = vdupq_n_f32(vaddvq_f32(vreinterpretq_f32_u32(products)));
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(sum), vld1q_u32(outputs.data())));
+#else
+        float products[4];
+        for(int i = 0; i < 4; ++i) products[i] = inputs[i] ? lhs.V[i] * rhs.V[i] : 0.f;
+
+        const float sum = (products[0] + products[1]) + (products[2] + products[3]);
+        return {{outputs[0] ? sum : 0.f, outputs[1] ? sum : 0.f, outputs[2] ? sum : 0.f, outputs[3] ? sum : 0.f}};
+#endif
 #endif
     }
 
@@ -75,6 +197,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_cvtss_f32(val);
 #elif defined(ENGINE_SIMD_NEON)
+        return vgetq_lane_f32(val, 0);
+#else
+        return val.V[0];
 #endif
     }
 
@@ -89,6 +214,75 @@ namespace simd {
         Floats cmp = _mm_cmplt_ps(absDiff, eps);
 
         return (_mm_movemask_ps(cmp) == 0xF);
+#elif defined(ENGINE_SIMD_NEON)
+        const uint32x4_t cmp = vcltq_f32(vabdq_f32(a, b), vdupq_n_f32(epsilon));
+        return vminvq_u32(cmp) == ~0u;
+#else
+        for(int i = 0; i < 4; ++i) {
+            if(!(std::abs(a.V[i] - b.V[i]) < epsilon)) return false;
+        }
+        return true;
+#endif
+    }
+
+    // Comparisons
+    inline Floats Less(const Floats& lhs, const Floats& rhs) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_cmplt_ps(lhs, rhs);
+#elif defined(ENGINE_SIMD_NEON)
+        return vreinterpretq_f32_u32(vcltq_f32(lhs, rhs));
+#else
+        return {{ToMask(lhs.V[0] < rhs.V[0]), ToMask(lhs.V[1] < rhs.V[1]), ToMask(lhs.V[2] < rhs.V[2]),
+                 ToMask(lhs.V[3] < rhs.V[3])}};
+#endif
+    }
+
+    inline Floats LessEqual(const Floats& lhs, const Floats& rhs) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_cmple_ps(lhs, rhs);
+#elif defined(ENGINE_SIMD_NEON)
+        return vreinterpretq_f32_u32(vcleq_f32(lhs, rhs));
+#else
+        return {{ToMask(lhs.V[0] <= rhs.V[0]), ToMask(lhs.V[1] <= rhs.V[1]), ToMask(lhs.V[2] <= rhs.V[2]),
+                 ToMask(lhs.V[3] <= rhs.V[3])}};
+#endif
+    }
+
+    inline Floats And(const Floats& lhs, const Floats& rhs) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_and_ps(lhs, rhs);
+#elif defined(ENGINE_SIMD_NEON)
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(lhs), vreinterpretq_u32_f32(rhs)));
+#else
+        Floats res;
+        for(int i = 0; i < 4; ++i) res.V[i] = ToFloat(ToBits(lhs.V[i]) & ToBits(rhs.V[i]));
+        return res;
+#endif
+    }
+
+    inline Floats Xor(const Floats& lhs, const Floats& rhs) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_xor_ps(lhs, rhs);
+#elif defined(ENGINE_SIMD_NEON)
+        return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(lhs), vreinterpretq_u32_f32(rhs)));
+#else
+        Floats res;
+        for(int i = 0; i < 4; ++i) res.V[i] = ToFloat(ToBits(lhs.V[i]) ^ ToBits(rhs.V[i]));
+        return res;
+#endif
+    }
+
+    inline int GetMask(const Floats& val) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_movemask_ps(val);
+#elif defined(ENGINE_SIMD_NEON)
+        static const int32_t shifts[4] = {0, 1, 2, 3};
+        const uint32x4_t signs = vshrq_n_u32(vreinterpretq_u32_f32(val), 31);
+        return static_cast<int>(vaddvq_u32(vshlq_u32(signs, vld1q_s32(shifts))));
+#else
+        int mask = 0;
+        for(int i = 0; i < 4; ++i) mask |= static_cast<int>(ToBits(val.V[i]) >> 31) << i;
+        return mask;
 #endif
     }
 
@@ -97,6 +291,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_setzero_ps();
 #elif defined(ENGINE_SIMD_NEON)
+        return vdupq_n_f32(0.f);
+#else
+        return {};
 #endif
     }
 
@@ -104,6 +301,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_set1_ps(val);
 #elif defined(ENGINE_SIMD_NEON)
+        return vdupq_n_f32(val);
+#else
+        return {{val, val, val, val}};
 #endif
     }
 
@@ -111,6 +311,30 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_set_ps(w, z, y, x);
 #elif defined(ENGINE_SIMD_NEON)
+        const float values[4] = {x, y, z, w};
+        return vld1q_f32(values);
+#else
+        return {{x, y, z, w}};
+#endif
+    }
+
+    inline Floats Load(const float* src) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        return _mm_loadu_ps(src);
+#elif defined(ENGINE_SIMD_NEON)
+        return vld1q_f32(src);
+#else
+        return {{src[0], src[1], src[2], src[3]}};
+#endif
+    }
+
+    inline void Store(float* dst, const Floats& val) noexcept {
+#ifdef ENGINE_SIMD_SSE
+        _mm_storeu_ps(dst, val);
+#elif defined(ENGINE_SIMD_NEON)
+        vst1q_f32(dst, val);
+#else
+        for(int i = 0; i < 4; ++i) dst[i] = val.V[i];
 #endif
     }
 
@@ -118,6 +342,11 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_shuffle_ps(lhs, rhs, MASK);
 #elif defined(ENGINE_SIMD_NEON)
+        static constexpr std::array<std::uint8_t, 16> table = GetShuffleTable<MASK, 16>();
+        const uint8x16x2_t sources = {{vreinterpretq_u8_f32(lhs), vreinterpretq_u8_f32(rhs)}};
+        return vreinterpretq_f32_u8(vqtbl2q_u8(sources, vld1q_u8(table.data())));
+#else
+        return {{lhs.V[MASK & 3], lhs.V[(MASK >> 2) & 3], rhs.V[(MASK >> 4) & 3], rhs.V[(MASK >> 6) & 3]}};
 #endif
     }
 
@@ -125,6 +354,10 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(v), MASK));
 #elif defined(ENGINE_SIMD_NEON)
+        static constexpr std::array<std::uint8_t, 16> table = GetShuffleTable<MASK, 0>();
+        return vreinterpretq_f32_u8(vqtbl1q_u8(vreinterpretq_u8_f32(v), vld1q_u8(table.data())));
+#else
+        return Shuffle<MASK>(v, v);
 #endif
     }
 
@@ -132,6 +365,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_unpackhi_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vzip2q_f32(lhs, rhs);
+#else
+        return {{lhs.V[2], rhs.V[2], lhs.V[3], rhs.V[3]}};
 #endif
     }
 
@@ -139,6 +375,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_unpacklo_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vzip1q_f32(lhs, rhs);
+#else
+        return {{lhs.V[0], rhs.V[0], lhs.V[1], rhs.V[1]}};
 #endif
     }
 
@@ -146,6 +385,9 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_movelh_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vcombine_f32(vget_low_f32(lhs), vget_low_f32(rhs));
+#else
+        return {{lhs.V[0], lhs.V[1], rhs.V[0], rhs.V[1]}};
 #endif
     }
 
@@ -153,6 +395,198 @@ namespace simd {
 #ifdef ENGINE_SIMD_SSE
         return _mm_movehl_ps(lhs, rhs);
 #elif defined(ENGINE_SIMD_NEON)
+        return vcombine_f32(vget_high_f32(rhs), vget_high_f32(lhs));
+#else
+        return {{rhs.V[2], rhs.V[3], lhs.V[2], lhs.V[3]}};
+#endif
+    }
+
+    // Eight lanes: one AVX register when the build targets AVX, otherwise a pair of Floats
+#ifdef ENGINE_SIMD_AVX
+    typedef __m256 Floats8;
+#else
+    struct Floats8 {
+        Floats Low;
+        Floats High;
+    };
+#endif
+
+    inline Floats8 Add(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_add_ps(lhs, rhs);
+#else
+        return {Add(lhs.Low, rhs.Low), Add(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 Sub(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_sub_ps(lhs, rhs);
+#else
+        return {Sub(lhs.Low, rhs.Low), Sub(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 Mul(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_mul_ps(lhs, rhs);
+#else
+        return {Mul(lhs.Low, rhs.Low), Mul(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 Div(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_div_ps(lhs, rhs);
+#else
+        return {Div(lhs.Low, rhs.Low), Div(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 Sqrt(const Floats8& val) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_sqrt_ps(val);
+#else
+        return {Sqrt(val.Low), Sqrt(val.High)};
+#endif
+    }
+
+    inline Floats8 Round(const Floats8& val) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 truncated = _mm256_round_ps(val, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        const __m256 fraction = _mm256_andnot_ps(signMask, _mm256_sub_ps(val, truncated));
+        const __m256 sign = _mm256_and_ps(val, signMask);
+        const __m256 step = _mm256_or_ps(sign, _mm256_set1_ps(1.f));
+        const __m256 half = _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+        return _mm256_or_ps(_mm256_add_ps(truncated, _mm256_and_ps(step, half)), sign);
+#else
+        return {Round(val.Low), Round(val.High)};
+#endif
+    }
+
+    inline Floats8 Less(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_cmp_ps(lhs, rhs, _CMP_LT_OQ);
+#else
+        return {Less(lhs.Low, rhs.Low), Less(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 LessEqual(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OQ);
+#else
+        return {LessEqual(lhs.Low, rhs.Low), LessEqual(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 And(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_and_ps(lhs, rhs);
+#else
+        return {And(lhs.Low, rhs.Low), And(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline Floats8 Xor(const Floats8& lhs, const Floats8& rhs) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_xor_ps(lhs, rhs);
+#else
+        return {Xor(lhs.Low, rhs.Low), Xor(lhs.High, rhs.High)};
+#endif
+    }
+
+    inline int GetMask(const Floats8& val) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_movemask_ps(val);
+#else
+        return GetMask(val.Low) | GetMask(val.High) << 4;
+#endif
+    }
+
+    inline Floats8 Reset8() noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_setzero_ps();
+#else
+        return {Reset(), Reset()};
+#endif
+    }
+
+    inline Floats8 Set8(const float val) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_set1_ps(val);
+#else
+        return {Set(val), Set(val)};
+#endif
+    }
+
+    inline Floats8 Load8(const float* src) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        return _mm256_loadu_ps(src);
+#else
+        return {Load(src), Load(src + 4)};
+#endif
+    }
+
+    inline void Store(float* dst, const Floats8& val) noexcept {
+#ifdef ENGINE_SIMD_AVX
+        _mm256_storeu_ps(dst, val);
+#else
+        Store(dst, val.Low);
+        Store(dst + 4, val.High);
+#endif
+    }
+
+    // Runtime dispatch
+    struct Features {
+        bool AVX2 = false;
+        bool AVX512 = false;
+        bool NEON = false;
+    };
+
+    inline Features DetectFeatures() noexcept {
+        Features features;
+#ifdef ENGINE_SIMD_SSE
+        std::uint32_t leaf1[4] = {};
+        std::uint32_t leaf7[4] = {};
+        std::uint64_t xcr0 = 0;
+
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        const bool hasLeaf7 = regs[0] >= 7;
+
+        __cpuid(reinterpret_cast<int*>(leaf1), 1);
+        if(hasLeaf7) __cpuidex(reinterpret_cast<int*>(leaf7), 7, 0);
+        if(leaf1[2] >> 27 & 1u) xcr0 = _xgetbv(0);
+#else
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+
+        if(leaf1[2] >> 27 & 1u) {
+            std::uint32_t low;
+            std::uint32_t high;
+            __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            xcr0 = static_cast<std::uint64_t>(high) << 32 | low;
+        }
+#endif
+
+        // The OS has to save YMM state for AVX, and opmask plus both ZMM halves for AVX-512
+        const bool avxState = (xcr0 & 0x6) == 0x6 && (leaf1[2] >> 28 & 1u);
+        const bool avx512State = avxState && (xcr0 & 0xE0) == 0xE0;
+
+        features.AVX2 = avxState && (leaf7[1] >> 5 & 1u);
+        features.AVX512 = avx512State && (leaf7[1] >> 16 & 1u);
+#elif defined(ENGINE_SIMD_NEON)
+        features.NEON = true;
 #endif
+        return features;
+    }
+
+    // Detected once; clearing a flag forces the narrower kernels, which is how the fallback paths get exercised
+    inline Features& GetFeatures() noexcept {
+        static Features features = DetectFeatures();
+        return features;
     }
 }
@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../math/Math.hpp"
+#include "Mesh.hpp"
+#include "Optimizer.hpp"
+#include "Simplify.hpp"
+
+namespace mesh {
+    constexpr inline std::size_t LOD_MAX_LEVELS = 6;
+    constexpr inline float LOD_REDUCTION = 0.5f;
+    constexpr inline float LOD_PIXEL_ERROR = 1.f;
+    constexpr inline float LOD_HYSTERESIS = 0.25f;
+
+    struct LodLevel {
+        Mesh Geometry;
+        float Error = 0.f; // Object-space deviation from level 0
+    };
+
+    // Levels from full detail down, each about LOD_REDUCTION of the triangles of the one before, with the bounding
+    // sphere every level shares
+    struct LodChain {
+        std::vector<LodLevel> Levels;
+        math::Vector Center;
+        float Radius = 0.f;
+    };
+
+    // Offline: simplifies the source to successive triangle targets and cache-optimizes every level. The chain
+    // stops early once a level no longer sheds at least a tenth of the triangles of the one before
+    inline LodChain BuildLodChain(const Mesh& source, const std::size_t maxLevels = LOD_MAX_LEVELS,
+                                  const float reduction = LOD_REDUCTION) {
+        LodChain chain;
+        if(source.Vertices.empty()) return chain;
+
+        math::Vector minPos = source.Vertices[0].Pos;
+        math::Vector maxPos = source.Vertices[0].Pos;
+        for(const shader::Vertex& v : source.Vertices) {
+            minPos = math::Vector(std::min(minPos.X, v.Pos.X), std::min(minPos.Y, v.Pos.Y),
+                                  std::min(minPos.Z, v.Pos.Z));
+            maxPos = math::Vector(std::max(maxPos.X, v.Pos.X), std::max(maxPos.Y, v.Pos.Y),
+                                  std::max(maxPos.Z, v.Pos.Z));
+        }
+
+        chain.Center = (minPos + maxPos) * 0.5f;
+        chain.Center.W = 1.f;
+        for(const shader::Vertex& v : source.Vertices) {
+            chain.Radius = std::max(chain.Radius, (v.Pos - chain.Center).Length());
+        }
+
+        chain.Levels.push_back({source, 0.f});
+        std::size_t triangles = source.Indices.size() / 3;
+
+        while(chain.Levels.size() < maxLevels) {
+            const std::size_t target = static_cast<std::size_t>(static_cast<float>(triangles) * reduction);
+            SimplifyResult simplified = SimplifyMesh(source, target);
+
+            const std::size_t reached = simplified.Geometry.Indices.size() / 3;
+            if(reached == 0 || reached * 10 > triangles * 9) break;
+
+            Mesh& level = simplified.Geometry;
+            level.Indices = OptimizeVertexCache(level.Indices, level.Vertices.size());
+            OptimizeVertexFetch(level.Vertices, level.Indices);
+
+            chain.Levels.push_back({std::move(level), std::max(simplified.Error, chain.Levels.back().Error)});
+            triangles = reached;
+        }
+
+        return chain;
+    }
+
+    // How many pixels one object-space unit at the chain's center covers on screen. projection is a
+    // CreatePerspective matrix and viewportHeight the target height in pixels
+    inline float GetPixelsPerUnit(const LodChain& chain, const math::Matrix& modelView, const math::Matrix& projection,
+                                  const std::uint32_t viewportHeight) noexcept {
+        const math::Vector center = modelView * chain.Center;
+        const float distance = -center.Z;
+        if(distance <= 0.f) return INFINITY;
+
+        float scale = 0.f;
+        for(int axis = 0; axis < 3; ++axis) {
+            const math::Vector column(modelView[axis][0], modelView[axis][1], modelView[axis][2]);
+            scale = std::max(scale, column.Length());
+        }
+
+        return scale * projection[1][1] * 0.5f * static_cast<float>(viewportHeight) / distance;
+    }
+
+    // Per-instance choice that only moves once the projected error leaves a band around the pixel budget, so an
+    // instance near a switch distance does not pop back and forth every frame
+    struct LodSelector {
+        std::size_t Current = 0;
+
+        // The coarsest level whose error stays within pixelError on screen. A coarser level is only taken once it
+        // fits (1 - hysteresis) of the budget, and a finer one only once the current level exceeds
+        // (1 + hysteresis) of it
+        inline std::size_t Select(const LodChain& chain, const math::Matrix& modelView, const math::Matrix& projection,
+                                  const std::uint32_t viewportHeight, const float pixelError = LOD_PIXEL_ERROR,
+                                  const float hysteresis = LOD_HYSTERESIS) noexcept {
+            if(chain.Levels.empty()) return Current = 0;
+
+            const float pixelsPerUnit = GetPixelsPerUnit(chain, modelView, projection, viewportHeight);
+
+            auto Coarsest = [&](const float budget) {
+                std::size_t level = 0;
+                for(std::size_t i = 1; i < chain.Levels.size(); ++i) {
+                    if(chain.Levels[i].Error * pixelsPerUnit <= budget) level = i;
+                }
+                return level;
+            };
+
+            const std::size_t coarser = Coarsest(pixelError * (1.f - hysteresis));
+            const std::size_t finer = Coarsest(pixelError * (1.f + hysteresis));
+
+            Current = std::clamp(Current, coarser, std::max(coarser, finer));
+            return Current;
+        }
+    };
+}
\ No newline at end of file
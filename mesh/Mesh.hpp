@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../graphics/Shader.hpp"
+#include "../math/Math.hpp"
+
+namespace mesh {
+    struct Mesh {
+        std::vector<shader::Vertex> Vertices;
+        std::vector<std::uint32_t> Indices;
+    };
+
+    // UV sphere with counter-clockwise outer faces, colored by its normal; rows are emitted pole to pole
+    inline Mesh CreateSphere(const std::uint32_t slices, const std::uint32_t stacks, const float radius = 1.f) {
+        Mesh sphere;
+        sphere.Vertices.reserve(static_cast<std::size_t>(slices + 1) * (stacks + 1));
+        sphere.Indices.reserve(static_cast<std::size_t>(slices) * stacks * 6);
+
+        for(std::uint32_t stack = 0; stack <= stacks; ++stack) {
+            const float polar = math::ToRadian(180.f) * static_cast<float>(stack) / static_cast<float>(stacks);
+
+            for(std::uint32_t slice = 0; slice <= slices; ++slice) {
+                const float azimuth = math::ToRadian(360.f) * static_cast<float>(slice) / static_cast<float>(slices);
+                const math::Vector normal(std::sin(polar) * std::sin(azimuth), std::cos(polar),
+                                          std::sin(polar) * std::cos(azimuth));
+
+                sphere.Vertices.push_back({normal * radius + math::Vector(0.f, 0.f, 0.f, 1.f),
+                                           normal * 0.5f + math::Vector(0.5f, 0.5f, 0.5f, 1.f)});
+            }
+        }
+
+        for(std::uint32_t stack = 0; stack < stacks; ++stack) {
+            for(std::uint32_t slice = 0; slice < slices; ++slice) {
+                const std::uint32_t top = stack * (slices + 1) + slice;
+                const std::uint32_t bottom = top + slices + 1;
+
+                if(stack != 0) sphere.Indices.insert(sphere.Indices.end(), {top, bottom, top + 1});
+                if(stack + 1 != stacks) sphere.Indices.insert(sphere.Indices.end(), {top + 1, bottom, bottom + 1});
+            }
+        }
+
+        return sphere;
+    }
+
+    // count concentric UV spheres of radius 1/count up to 1, innermost first, so drawing them in index order with
+    // depth testing shades every shell and leaves real depth complexity for an overdraw optimizer to remove
+    inline Mesh CreateNestedSpheres(const std::uint32_t count, const std::uint32_t slices, const std::uint32_t stacks) {
+        Mesh nested;
+
+        for(std::uint32_t i = 1; i <= count; ++i) {
+            const Mesh shell = CreateSphere(slices, stacks, static_cast<float>(i) / static_cast<float>(count));
+            const std::uint32_t base = static_cast<std::uint32_t>(nested.Vertices.size());
+
+            nested.Vertices.insert(nested.Vertices.end(), shell.Vertices.begin(), shell.Vertices.end());
+            for(const std::uint32_t index : shell.Indices) nested.Indices.push_back(base + index);
+        }
+
+        return nested;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,370 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "../graphics/FrameBuffer.hpp"
+#include "../graphics/Rasterizer.hpp"
+#include "../graphics/Shader.hpp"
+#include "../math/Math.hpp"
+
+namespace mesh {
+    // The rasterizer transforms every vertex of a draw once and has no post-transform vertex cache, so ACMR and ATVR
+    // are measured against a simulated FIFO and their gains only pay off with a future indexed cache; today the new
+    // orders help through index and fetch locality and early depth rejection
+    constexpr inline std::uint32_t VERTEX_CACHE_SIZE = 16;
+    constexpr inline float OVERDRAW_THRESHOLD = 1.05f;
+    constexpr inline std::uint32_t OVERDRAW_VIEW_SIZE = 256;
+
+    struct VertexCacheStats {
+        std::size_t Transformed = 0;
+        float ACMR = 0.f; // Transformed vertices per triangle
+        float ATVR = 0.f; // Transformed vertices per referenced vertex
+    };
+
+    struct MeshStats {
+        VertexCacheStats Cache;
+        float Overdraw = 0.f; // Shaded fragments per covered pixel
+    };
+
+    struct OptimizeReport {
+        MeshStats Before;
+        MeshStats After;
+    };
+
+    // Drops triangles that reference a vertex past vertexCount, as Render does when drawing them
+    inline std::vector<std::uint32_t> GetValidTriangles(const std::vector<std::uint32_t>& indices,
+                                                        const std::size_t vertexCount) {
+        std::vector<std::uint32_t> valid;
+        valid.reserve(indices.size());
+
+        for(std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) continue;
+            valid.insert(valid.end(), {indices[i], indices[i + 1], indices[i + 2]});
+        }
+
+        return valid;
+    }
+
+    // Simulates a FIFO post-transform cache of cacheSize entries over the index stream
+    inline VertexCacheStats AnalyzeVertexCache(const std::vector<std::uint32_t>& indices, const std::size_t vertexCount,
+                                               const std::uint32_t cacheSize = VERTEX_CACHE_SIZE) {
+        std::vector<std::uint32_t> timestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        std::uint32_t time = cacheSize + 1;
+
+        VertexCacheStats stats;
+        std::size_t triangles = 0;
+        std::size_t unique = 0;
+
+        for(std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) continue;
+
+            for(std::size_t corner = i; corner < i + 3; ++corner) {
+                const std::uint32_t v = indices[corner];
+                if(time - timestamps[v] > cacheSize) {
+                    timestamps[v] = time++;
+                    ++stats.Transformed;
+                }
+                if(!referenced[v]) {
+                    referenced[v] = true;
+                    ++unique;
+                }
+            }
+            ++triangles;
+        }
+
+        stats.ACMR = triangles > 0 ? static_cast<float>(stats.Transformed) / static_cast<float>(triangles) : 0.f;
+        stats.ATVR = unique > 0 ? static_cast<float>(stats.Transformed) / static_cast<float>(unique) : 0.f;
+        return stats;
+    }
+
+    // Renders the mesh from the six axis directions with depth testing and back-face culling, and returns the
+    // number of shaded fragments per covered pixel
+    inline float AnalyzeOverdraw(const std::vector<shader::Vertex>& vertices,
+                                 const std::vector<std::uint32_t>& indices,
+                                 const std::uint32_t viewSize = OVERDRAW_VIEW_SIZE) {
+        struct CountingShader {
+            shader::Default Base;
+            std::size_t* Shaded;
+
+            inline math::Vector Vertex(const math::Vector& pos) const { return Base.Vertex(pos); }
+            inline std::uint32_t Color(const math::Vector&) const {
+                ++*Shaded;
+                return 0xFFFFFFFF;
+            }
+        };
+
+        if(vertices.empty()) return 0.f;
+
+        math::Vector minPos = vertices[0].Pos;
+        math::Vector maxPos = vertices[0].Pos;
+        for(const shader::Vertex& v : vertices) {
+            minPos = math::Vector(std::min(minPos.X, v.Pos.X), std::min(minPos.Y, v.Pos.Y),
+                                  std::min(minPos.Z, v.Pos.Z));
+            maxPos = math::Vector(std::max(maxPos.X, v.Pos.X), std::max(maxPos.Y, v.Pos.Y),
+                                  std::max(maxPos.Z, v.Pos.Z));
+        }
+
+        const math::Vector center = (minPos + maxPos) * 0.5f;
+        const float radius = std::max(0.5f * (maxPos - minPos).Length(), 1e-3f);
+
+        const math::Vector directions[6] = {{1.f, 0.f, 0.f},  {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f},
+                                            {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f},  {0.f, 0.f, -1.f}};
+        const math::Matrix proj = math::CreatePerspective(math::ToRadian(45.f), 1.f, radius, 5.f * radius);
+        const math::Matrix viewport =
+            math::CreateViewport(static_cast<float>(viewSize), static_cast<float>(viewSize));
+
+        graphics::FrameBuffer frame(viewSize, viewSize);
+        std::size_t shaded = 0;
+        std::size_t covered = 0;
+
+        for(const math::Vector& direction : directions) {
+            const math::Vector up = direction.Y != 0.f ? math::Vector(0.f, 0.f, 1.f) : math::Vector(0.f, 1.f, 0.f);
+            const math::Matrix view = math::CreateLookAt(center + direction * (3.f * radius), center, up);
+
+            frame.Clear(0);
+            graphics::Render(frame, CountingShader{{proj * view, viewport}, &shaded}, vertices, indices);
+
+            const std::uint32_t* colors = frame.GetColor();
+            covered += static_cast<std::size_t>(std::count(colors, colors + viewSize * viewSize, 0xFFFFFFFFu));
+        }
+
+        return covered > 0 ? static_cast<float>(shaded) / static_cast<float>(covered) : 0.f;
+    }
+
+    // Tipsify (Sander, Nehab and Barczak 2007): fans around one vertex at a time and moves on to the neighbour that
+    // will stay in a FIFO cache of cacheSize the longest, falling back to recent dead ends. Linear in the mesh size
+    inline std::vector<std::uint32_t> OptimizeVertexCache(const std::vector<std::uint32_t>& indices,
+                                                          const std::size_t vertexCount,
+                                                          const std::uint32_t cacheSize = VERTEX_CACHE_SIZE) {
+        const std::vector<std::uint32_t> triangles = GetValidTriangles(indices, vertexCount);
+        const std::size_t triangleCount = triangles.size() / 3;
+
+        // Triangles around each vertex, packed as offsets into one list
+        std::vector<std::uint32_t> live(vertexCount, 0);
+        for(const std::uint32_t v : triangles) ++live[v];
+
+        std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+        std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+
+        std::vector<std::uint32_t> adjacency(triangles.size());
+        std::vector<std::uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for(std::size_t i = 0; i < triangles.size(); ++i) {
+            adjacency[cursors[triangles[i]]++] = static_cast<std::uint32_t>(i / 3);
+        }
+
+        std::vector<std::uint32_t> timestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<std::uint32_t> deadEnds;
+        std::vector<std::uint32_t> candidates;
+
+        std::vector<std::uint32_t> output;
+        output.reserve(triangles.size());
+
+        std::uint32_t time = cacheSize + 1;
+        std::size_t scan = 0;
+
+        auto SkipDeadEnd = [&]() -> std::int64_t {
+            while(!deadEnds.empty()) {
+                const std::uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if(live[v] > 0) return v;
+            }
+
+            for(; scan < vertexCount; ++scan) {
+                if(live[scan] > 0) return static_cast<std::int64_t>(scan);
+            }
+            return -1;
+        };
+
+        for(std::int64_t fan = SkipDeadEnd(); fan >= 0;) {
+            candidates.clear();
+
+            for(std::uint32_t i = offsets[fan]; i < offsets[fan + 1]; ++i) {
+                const std::uint32_t triangle = adjacency[i];
+                if(emitted[triangle]) continue;
+
+                for(std::uint32_t corner = 0; corner < 3; ++corner) {
+                    const std::uint32_t v = triangles[triangle * 3 + corner];
+                    output.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    --live[v];
+
+                    if(time - timestamps[v] > cacheSize) timestamps[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // The candidate expected to remain cached longest after its remaining fan is emitted
+            std::int64_t next = -1;
+            std::int64_t best = -1;
+            for(const std::uint32_t v : candidates) {
+                if(live[v] == 0) continue;
+
+                std::int64_t priority = 0;
+                if(time - timestamps[v] + 2 * live[v] <= cacheSize) priority = time - timestamps[v];
+                if(priority > best) {
+                    best = priority;
+                    next = v;
+                }
+            }
+
+            fan = next >= 0 ? next : SkipDeadEnd();
+        }
+
+        return output;
+    }
+
+    // Splits the cache-ordered triangles into clusters and draws the outward-facing ones first, so they occlude the
+    // rest in the depth test. Clusters start where the cache restarts anyway, or wherever the cluster's own ACMR
+    // from a cold cache is within threshold of the whole mesh, which bounds the cache cost of reordering them
+    inline std::vector<std::uint32_t> OptimizeOverdraw(const std::vector<shader::Vertex>& vertices,
+                                                       const std::vector<std::uint32_t>& indices,
+                                                       const float threshold = OVERDRAW_THRESHOLD,
+                                                       const std::uint32_t cacheSize = VERTEX_CACHE_SIZE) {
+        const std::size_t vertexCount = vertices.size();
+        const std::vector<std::uint32_t> triangles = GetValidTriangles(indices, vertexCount);
+        const std::size_t triangleCount = triangles.size() / 3;
+        if(triangleCount == 0) return triangles;
+
+        const float meshACMR = AnalyzeVertexCache(triangles, vertexCount, cacheSize).ACMR;
+
+        std::vector<std::uint32_t> timestamps(vertexCount, 0);
+        std::uint32_t time = cacheSize + 1;
+
+        auto CountMisses = [&](const std::size_t triangle) {
+            std::uint32_t misses = 0;
+            for(std::size_t corner = triangle * 3; corner < triangle * 3 + 3; ++corner) {
+                const std::uint32_t v = triangles[corner];
+                if(time - timestamps[v] > cacheSize) {
+                    timestamps[v] = time++;
+                    ++misses;
+                }
+            }
+            return misses;
+        };
+
+        std::vector<std::size_t> clusterStarts;
+        std::size_t start = 0;
+        std::uint32_t clusterMisses = 0;
+
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            const std::uint32_t misses = CountMisses(t);
+
+            if(t == 0 || misses == 3) {
+                clusterStarts.push_back(t);
+                start = t;
+                clusterMisses = 0;
+            }
+
+            clusterMisses += misses;
+            const float clusterACMR = static_cast<float>(clusterMisses) / static_cast<float>(t + 1 - start);
+
+            if(t + 1 < triangleCount && clusterACMR <= threshold * meshACMR) {
+                clusterStarts.push_back(t + 1);
+                start = t + 1;
+                clusterMisses = 0;
+                time += cacheSize + 1;
+            }
+        }
+        clusterStarts.push_back(triangleCount);
+
+        // Area-weighted centroid and normal of each cluster, and of the whole mesh
+        const std::size_t clusterCount = clusterStarts.size() - 1;
+        std::vector<math::Vector> centroids(clusterCount);
+        std::vector<math::Vector> normals(clusterCount);
+        math::Vector meshCentroid;
+        float meshArea = 0.f;
+
+        for(std::size_t c = 0; c < clusterCount; ++c) {
+            float area = 0.f;
+
+            for(std::size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+                const math::Vector& p0 = vertices[triangles[t * 3]].Pos;
+                const math::Vector& p1 = vertices[triangles[t * 3 + 1]].Pos;
+                const math::Vector& p2 = vertices[triangles[t * 3 + 2]].Pos;
+
+                const math::Vector normal = (p1 - p0).Cross(p2 - p0);
+                const float triangleArea = normal.Length();
+                const math::Vector centroid = (p0 + p1 + p2) * (1.f / 3.f);
+
+                centroids[c] += centroid * triangleArea;
+                normals[c] += normal;
+                area += triangleArea;
+            }
+
+            meshCentroid += centroids[c];
+            meshArea += area;
+            if(area > 0.f) centroids[c] /= area;
+        }
+
+        if(meshArea > 0.f) meshCentroid /= meshArea;
+
+        std::vector<float> keys(clusterCount);
+        for(std::size_t c = 0; c < clusterCount; ++c) {
+            const float length = normals[c].Length();
+            keys[c] = length > 0.f ? (centroids[c] - meshCentroid).Dot(normals[c]) / length : 0.f;
+        }
+
+        std::vector<std::size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const std::size_t a, const std::size_t b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<std::uint32_t> output;
+        output.reserve(triangles.size());
+        for(const std::size_t c : order) {
+            output.insert(output.end(), triangles.begin() + clusterStarts[c] * 3,
+                          triangles.begin() + clusterStarts[c + 1] * 3);
+        }
+
+        return output;
+    }
+
+    // Renumbers vertices in the order the index buffer first references them, so vertex fetches walk memory
+    // forward; unreferenced vertices are dropped. Returns the new vertex count
+    inline std::size_t OptimizeVertexFetch(std::vector<shader::Vertex>& vertices,
+                                           std::vector<std::uint32_t>& indices) {
+        constexpr std::uint32_t UNUSED = ~0u;
+
+        indices = GetValidTriangles(indices, vertices.size());
+        std::vector<std::uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<shader::Vertex> fetched;
+        fetched.reserve(vertices.size());
+
+        for(std::uint32_t& index : indices) {
+            if(remap[index] == UNUSED) {
+                remap[index] = static_cast<std::uint32_t>(fetched.size());
+                fetched.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        vertices = std::move(fetched);
+        return vertices.size();
+    }
+
+    inline MeshStats AnalyzeMesh(const std::vector<shader::Vertex>& vertices,
+                                 const std::vector<std::uint32_t>& indices) {
+        return {AnalyzeVertexCache(indices, vertices.size()), AnalyzeOverdraw(vertices, indices)};
+    }
+
+    // Cache order, then overdraw order within its cache budget, then fetch order
+    inline OptimizeReport OptimizeMesh(std::vector<shader::Vertex>& vertices, std::vector<std::uint32_t>& indices,
+                                       const float overdrawThreshold = OVERDRAW_THRESHOLD) {
+        OptimizeReport report;
+        report.Before = AnalyzeMesh(vertices, indices);
+
+        indices = OptimizeVertexCache(indices, vertices.size());
+        indices = OptimizeOverdraw(vertices, indices, overdrawThreshold);
+        OptimizeVertexFetch(vertices, indices);
+
+        report.After = AnalyzeMesh(vertices, indices);
+        return report;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,315 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "../graphics/Shader.hpp"
+#include "../math/Math.hpp"
+#include "Mesh.hpp"
+
+namespace mesh {
+    // Open edges get a plane through them, perpendicular to their face and weighted this much, to keep silhouettes
+    constexpr inline double BOUNDARY_WEIGHT = 100.0;
+
+    // Symmetric 4x4 plane quadric (Garland and Heckbert 1997); Evaluate gives the summed squared distance of a point
+    // to every plane added, and Weight how many planes that sum is over
+    struct Quadric {
+        double A[10] = {};
+        double Weight = 0.0;
+
+        inline void AddPlane(const double a, const double b, const double c, const double d,
+                             const double weight = 1.0) noexcept {
+            const double plane[4] = {a, b, c, d};
+            int k = 0;
+            for(int i = 0; i < 4; ++i) {
+                for(int j = i; j < 4; ++j) A[k++] += weight * plane[i] * plane[j];
+            }
+            Weight += weight;
+        }
+
+        inline Quadric& operator+=(const Quadric& other) noexcept {
+            for(int i = 0; i < 10; ++i) A[i] += other.A[i];
+            Weight += other.Weight;
+            return *this;
+        }
+
+        inline double Evaluate(const math::Vector& p) const noexcept {
+            const double x = p.X;
+            const double y = p.Y;
+            const double z = p.Z;
+
+            return A[0] * x * x + 2.0 * A[1] * x * y + 2.0 * A[2] * x * z + 2.0 * A[3] * x + A[4] * y * y +
+                   2.0 * A[5] * y * z + 2.0 * A[6] * y + A[7] * z * z + 2.0 * A[8] * z + A[9];
+        }
+    };
+
+    struct SimplifyResult {
+        Mesh Geometry;
+        float Error = 0.f; // Largest RMS distance to the merged planes over every collapse made
+    };
+
+    // Collapses edges in order of quadric cost until at most targetTriangles remain or the next collapse would cost
+    // more than maxError. Each collapse moves the kept vertex to the cheapest of both ends and their midpoint, and is
+    // refused if it would pinch the surface or flip a remaining face. Vertices sharing position and color are
+    // welded first
+    inline SimplifyResult SimplifyMesh(const Mesh& source, const std::size_t targetTriangles,
+                                       const float maxError = INFINITY) {
+        // Weld exact duplicates so seams do not read as open edges
+        std::vector<shader::Vertex> vertices;
+        std::vector<std::uint32_t> remap(source.Vertices.size());
+        {
+            struct Key {
+                float Values[6];
+                inline bool operator==(const Key& other) const noexcept {
+                    return std::equal(Values, Values + 6, other.Values);
+                }
+            };
+            struct KeyHash {
+                inline std::size_t operator()(const Key& key) const noexcept {
+                    std::size_t hash = 0;
+                    for(const float value : key.Values) hash = hash * 31 + std::hash<float>{}(value);
+                    return hash;
+                }
+            };
+
+            std::unordered_map<Key, std::uint32_t, KeyHash> welded;
+            for(std::size_t i = 0; i < source.Vertices.size(); ++i) {
+                const shader::Vertex& v = source.Vertices[i];
+                const Key key = {{v.Pos.X, v.Pos.Y, v.Pos.Z, v.Color.X, v.Color.Y, v.Color.Z}};
+
+                const auto [it, added] = welded.try_emplace(key, static_cast<std::uint32_t>(vertices.size()));
+                if(added) vertices.push_back(v);
+                remap[i] = it->second;
+            }
+        }
+
+        const std::size_t vertexCount = vertices.size();
+        std::vector<std::uint32_t> triangles;
+        triangles.reserve(source.Indices.size());
+        for(std::size_t i = 0; i + 2 < source.Indices.size(); i += 3) {
+            const std::uint32_t* corner = &source.Indices[i];
+            if(corner[0] >= remap.size() || corner[1] >= remap.size() || corner[2] >= remap.size()) continue;
+
+            const std::uint32_t a = remap[corner[0]];
+            const std::uint32_t b = remap[corner[1]];
+            const std::uint32_t c = remap[corner[2]];
+            if(a != b && b != c && c != a) triangles.insert(triangles.end(), {a, b, c});
+        }
+
+        std::size_t triangleCount = triangles.size() / 3;
+        std::vector<bool> removed(triangleCount, false);
+        std::vector<std::vector<std::uint32_t>> faces(vertexCount);
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            for(int k = 0; k < 3; ++k) faces[triangles[t * 3 + k]].push_back(static_cast<std::uint32_t>(t));
+        }
+
+        auto GetNormal = [&](const math::Vector& a, const math::Vector& b, const math::Vector& c) {
+            return (b - a).Cross(c - a);
+        };
+
+        // Face planes, plus a perpendicular plane along every edge used by a single face
+        std::vector<Quadric> quadrics(vertexCount);
+        std::unordered_map<std::uint64_t, std::uint32_t> edgeUse;
+        auto EdgeKey = [](std::uint32_t a, std::uint32_t b) {
+            if(a > b) std::swap(a, b);
+            return (static_cast<std::uint64_t>(a) << 32) | b;
+        };
+
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            const std::uint32_t* corner = &triangles[t * 3];
+            const math::Vector normal =
+                GetNormal(vertices[corner[0]].Pos, vertices[corner[1]].Pos, vertices[corner[2]].Pos);
+            const float length = normal.Length();
+            if(length <= 0.f) continue;
+
+            const math::Vector n = normal / length;
+            const double d = -static_cast<double>(n.Dot(vertices[corner[0]].Pos));
+            for(int k = 0; k < 3; ++k) quadrics[corner[k]].AddPlane(n.X, n.Y, n.Z, d);
+            for(int k = 0; k < 3; ++k) ++edgeUse[EdgeKey(corner[k], corner[(k + 1) % 3])];
+        }
+
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            const std::uint32_t* corner = &triangles[t * 3];
+            const math::Vector normal =
+                GetNormal(vertices[corner[0]].Pos, vertices[corner[1]].Pos, vertices[corner[2]].Pos);
+
+            for(int k = 0; k < 3; ++k) {
+                const std::uint32_t a = corner[k];
+                const std::uint32_t b = corner[(k + 1) % 3];
+                if(edgeUse[EdgeKey(a, b)] != 1) continue;
+
+                const math::Vector edge = vertices[b].Pos - vertices[a].Pos;
+                const math::Vector side = edge.Cross(normal);
+                const float length = side.Length();
+                if(length <= 0.f) continue;
+
+                const math::Vector n = side / length;
+                const double d = -static_cast<double>(n.Dot(vertices[a].Pos));
+                quadrics[a].AddPlane(n.X, n.Y, n.Z, d, BOUNDARY_WEIGHT);
+                quadrics[b].AddPlane(n.X, n.Y, n.Z, d, BOUNDARY_WEIGHT);
+            }
+        }
+
+        struct Collapse {
+            double Cost;
+            std::uint32_t Keep;
+            std::uint32_t Remove;
+            std::uint32_t KeepVersion;
+            std::uint32_t RemoveVersion;
+            float T; // Where the kept vertex ends up between Keep (0) and Remove (1)
+
+            inline bool operator>(const Collapse& other) const noexcept { return Cost > other.Cost; }
+        };
+
+        std::vector<std::uint32_t> versions(vertexCount, 0);
+        std::vector<bool> dead(vertexCount, false);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+        auto Push = [&](const std::uint32_t a, const std::uint32_t b) {
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+
+            Collapse best{INFINITY, a, b, versions[a], versions[b], 0.f};
+            const double weight = std::max(q.Weight, 1.0);
+            for(const float t : {0.f, 1.f, 0.5f}) {
+                const double cost = q.Evaluate(vertices[a].Pos + (vertices[b].Pos - vertices[a].Pos) * t) / weight;
+                if(cost < best.Cost) {
+                    best.Cost = std::max(cost, 0.0);
+                    best.T = t;
+                }
+            }
+            heap.push(best);
+        };
+
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            for(int k = 0; k < 3; ++k) {
+                const std::uint32_t a = triangles[t * 3 + k];
+                const std::uint32_t b = triangles[t * 3 + (k + 1) % 3];
+                if(a < b || edgeUse[EdgeKey(a, b)] == 1) Push(a, b);
+            }
+        }
+
+        auto GetNeighbours = [&](const std::uint32_t vertex, std::vector<std::uint32_t>& out) {
+            out.clear();
+            for(const std::uint32_t t : faces[vertex]) {
+                if(removed[t]) continue;
+                for(int k = 0; k < 3; ++k) {
+                    if(triangles[t * 3 + k] != vertex) out.push_back(triangles[t * 3 + k]);
+                }
+            }
+
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        };
+
+        // Link condition: the two ends may only share the vertices opposite the edge, or the collapse would pinch
+        // the surface into a non-manifold one
+        std::vector<std::uint32_t> keepRing;
+        std::vector<std::uint32_t> goneRing;
+        auto Pinches = [&](const std::uint32_t keep, const std::uint32_t gone) {
+            GetNeighbours(keep, keepRing);
+            GetNeighbours(gone, goneRing);
+
+            std::size_t shared = 0;
+            for(const std::uint32_t v : goneRing) shared += std::binary_search(keepRing.begin(), keepRing.end(), v);
+
+            std::size_t edgeFaces = 0;
+            for(const std::uint32_t t : faces[keep]) {
+                const std::uint32_t* corner = &triangles[t * 3];
+                edgeFaces += !removed[t] && (corner[0] == gone || corner[1] == gone || corner[2] == gone);
+            }
+
+            return edgeFaces == 0 || shared != edgeFaces;
+        };
+
+        // Refuses collapses that would turn a face of either vertex around
+        auto Flips = [&](const std::uint32_t vertex, const std::uint32_t other, const math::Vector& target) {
+            for(const std::uint32_t t : faces[vertex]) {
+                if(removed[t]) continue;
+
+                const std::uint32_t* corner = &triangles[t * 3];
+                if(corner[0] == other || corner[1] == other || corner[2] == other) continue;
+
+                math::Vector moved[3];
+                for(int k = 0; k < 3; ++k) moved[k] = corner[k] == vertex ? target : vertices[corner[k]].Pos;
+
+                const math::Vector before =
+                    GetNormal(vertices[corner[0]].Pos, vertices[corner[1]].Pos, vertices[corner[2]].Pos);
+                const math::Vector after = GetNormal(moved[0], moved[1], moved[2]);
+                if(before.Dot(after) <= 0.f) return true;
+            }
+            return false;
+        };
+
+        SimplifyResult result;
+        std::vector<std::uint32_t> neighbours;
+
+        while(triangleCount > targetTriangles && !heap.empty()) {
+            const Collapse collapse = heap.top();
+            heap.pop();
+
+            const std::uint32_t keep = collapse.Keep;
+            const std::uint32_t gone = collapse.Remove;
+            if(dead[keep] || dead[gone] || versions[keep] != collapse.KeepVersion ||
+               versions[gone] != collapse.RemoveVersion)
+                continue;
+
+            const float error = static_cast<float>(std::sqrt(collapse.Cost));
+            if(error > maxError) break;
+
+            const math::Vector target = vertices[keep].Pos + (vertices[gone].Pos - vertices[keep].Pos) * collapse.T;
+            if(Pinches(keep, gone) || Flips(keep, gone, target) || Flips(gone, keep, target)) continue;
+
+            vertices[keep] = {target,
+                              vertices[keep].Color + (vertices[gone].Color - vertices[keep].Color) * collapse.T};
+            quadrics[keep] += quadrics[gone];
+            dead[gone] = true;
+            ++versions[keep];
+            result.Error = std::max(result.Error, error);
+
+            for(const std::uint32_t t : faces[gone]) {
+                if(removed[t]) continue;
+
+                std::uint32_t* corner = &triangles[t * 3];
+                if(corner[0] == keep || corner[1] == keep || corner[2] == keep) {
+                    removed[t] = true;
+                    --triangleCount;
+                    continue;
+                }
+
+                for(int k = 0; k < 3; ++k) corner[k] = corner[k] == gone ? keep : corner[k];
+                faces[keep].push_back(t);
+            }
+            faces[gone].clear();
+
+            // Only edges around the moved vertex change cost; the version bump retires their old entries
+            std::erase_if(faces[keep], [&](const std::uint32_t t) { return removed[t]; });
+            GetNeighbours(keep, neighbours);
+            for(const std::uint32_t v : neighbours) Push(keep, v);
+        }
+
+        // Compact what is left, keeping vertices in first-use order
+        constexpr std::uint32_t UNUSED = ~0u;
+        std::vector<std::uint32_t> compact(vertexCount, UNUSED);
+
+        for(std::size_t t = 0; t < removed.size(); ++t) {
+            if(removed[t]) continue;
+
+            for(int k = 0; k < 3; ++k) {
+                std::uint32_t& index = compact[triangles[t * 3 + k]];
+                if(index == UNUSED) {
+                    index = static_cast<std::uint32_t>(result.Geometry.Vertices.size());
+                    result.Geometry.Vertices.push_back(vertices[triangles[t * 3 + k]]);
+                }
+                result.Geometry.Indices.push_back(index);
+            }
+        }
+
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "../math/Math.hpp"
+
+namespace regression {
+    constexpr inline int BENCH_RUNS = 21;
+
+    // Elements processed per timed run, spread over as many calls as the element count needs
+    constexpr inline std::size_t BENCH_ELEMENTS_PER_RUN = 1 << 20;
+
+    // A dispatch target of math::Batch, selected by clearing the wider feature flags
+    struct BenchTarget {
+        const char* Name;
+        bool AVX2;
+        bool AVX512;
+    };
+
+    // Best time of BENCH_RUNS runs, in microseconds per call of run
+    template <typename Run> inline double MeasureMicroseconds(const std::size_t calls, Run&& run) {
+        double best = 0.0;
+        for(int i = 0; i < BENCH_RUNS; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            for(std::size_t call = 0; call < calls; ++call) run();
+
+            const double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                                    .count() / static_cast<double>(calls);
+            best = i == 0 ? time : std::min(best, time);
+        }
+
+        return best;
+    }
+
+    inline float GetDifference(const math::Vector& a, const math::Vector& b) noexcept {
+        return std::max({std::abs(a.X - b.X), std::abs(a.Y - b.Y), std::abs(a.Z - b.Z), std::abs(a.W - b.W)});
+    }
+
+    inline float GetDifference(const math::Matrix& a, const math::Matrix& b) noexcept {
+        float difference = 0.f;
+        for(int col = 0; col < 4; ++col) {
+            for(int row = 0; row < 4; ++row) difference = std::max(difference, std::abs(a[col][row] - b[col][row]));
+        }
+
+        return difference;
+    }
+
+    // Times TransformVectors, MultiplyMatrices, NormalizeVectors and QuaternionsToMatrices over count elements on
+    // every dispatch target the CPU supports, against a loop of the per-element Vector, Matrix and Quaternion
+    // operators, and prints each target's largest difference from those operators
+    inline int RunBatchBench(const std::size_t count) {
+        if(count == 0) return 1;
+
+        std::vector<math::Vector> vectors(count);
+        std::vector<math::Matrix> lhs(count);
+        std::vector<math::Matrix> rhs(count);
+        std::vector<math::Quaternion> rotations(count);
+        math::Vectors batchVectors(count);
+        math::Matrices batchLhs(count);
+        math::Matrices batchRhs(count);
+        math::Quaternions batchRotations(count);
+
+        for(std::size_t i = 0; i < count; ++i) {
+            const float t = static_cast<float>(i) * 0.37f;
+            vectors[i] = math::Vector(std::sin(t), std::cos(t) * 2.f, t * 0.01f + 0.5f, 1.f);
+            lhs[i] = math::CreateRotation({0.f, 1.f, 0.f}, t) * math::CreateScale({1.f, 1.f + 0.001f * t, 1.f});
+            rhs[i] = math::CreateTranslation(math::Vector(t, -t, 1.f)) * math::CreateRotation({1.f, 0.f, 0.f}, -t);
+            rotations[i] = math::Quaternion(math::Vector(std::sin(t), 0.5f, std::cos(t)), 0.7f).Norm();
+
+            batchVectors.Set(i, vectors[i]);
+            batchLhs.Set(i, lhs[i]);
+            batchRhs.Set(i, rhs[i]);
+            batchRotations.Set(i, rotations[i]);
+        }
+
+        const math::Matrix transform = lhs[count / 2];
+        const std::size_t calls = std::max<std::size_t>(1, BENCH_ELEMENTS_PER_RUN / count);
+
+        std::vector<math::Vector> vectorOut(count);
+        std::vector<math::Matrix> matrixOut(count);
+
+        const double each[4] = {
+            MeasureMicroseconds(calls, [&] {
+                for(std::size_t i = 0; i < count; ++i) vectorOut[i] = transform * vectors[i];
+            }),
+            MeasureMicroseconds(calls, [&] {
+                for(std::size_t i = 0; i < count; ++i) matrixOut[i] = lhs[i] * rhs[i];
+            }),
+            MeasureMicroseconds(calls, [&] {
+                for(std::size_t i = 0; i < count; ++i) vectorOut[i] = vectors[i].Norm();
+            }),
+            MeasureMicroseconds(calls, [&] {
+                for(std::size_t i = 0; i < count; ++i) matrixOut[i] = rotations[i].ToMatrix();
+            }),
+        };
+
+        // References for the batched results
+        std::vector<math::Vector> transformed(count);
+        std::vector<math::Matrix> products(count);
+        std::vector<math::Vector> normalized(count);
+        std::vector<math::Matrix> rotationMatrices(count);
+        for(std::size_t i = 0; i < count; ++i) {
+            transformed[i] = transform * vectors[i];
+            products[i] = lhs[i] * rhs[i];
+            normalized[i] = vectors[i].Norm();
+            rotationMatrices[i] = rotations[i].ToMatrix();
+        }
+
+        simd::Features& features = simd::GetFeatures();
+        const simd::Features detected = features;
+
+        std::vector<BenchTarget> targets = {{"portable", false, false}};
+        if(detected.AVX2) targets.push_back({"avx2", true, false});
+        if(detected.AVX512) targets.push_back({"avx512", detected.AVX2, true});
+
+        double batched[4][3] = {};
+        float difference[3] = {};
+        math::Vectors vectorsOut;
+        math::Matrices matricesOut;
+
+        for(std::size_t target = 0; target < targets.size(); ++target) {
+            features.AVX2 = targets[target].AVX2;
+            features.AVX512 = targets[target].AVX512;
+
+            batched[0][target] = MeasureMicroseconds(
+                calls, [&] { math::TransformVectors(transform, batchVectors, vectorsOut); });
+            for(std::size_t i = 0; i < count; ++i) {
+                difference[target] = std::max(difference[target], GetDifference(vectorsOut.Get(i), transformed[i]));
+            }
+
+            batched[1][target] =
+                MeasureMicroseconds(calls, [&] { math::MultiplyMatrices(batchLhs, batchRhs, matricesOut); });
+            for(std::size_t i = 0; i < count; ++i) {
+                difference[target] = std::max(difference[target], GetDifference(matricesOut.Get(i), products[i]));
+            }
+
+            batched[2][target] = MeasureMicroseconds(calls, [&] { math::NormalizeVectors(batchVectors, vectorsOut); });
+            for(std::size_t i = 0; i < count; ++i) {
+                difference[target] = std::max(difference[target], GetDifference(vectorsOut.Get(i), normalized[i]));
+            }
+
+            batched[3][target] =
+                MeasureMicroseconds(calls, [&] { math::QuaternionsToMatrices(batchRotations, matricesOut); });
+            for(std::size_t i = 0; i < count; ++i) {
+                difference[target] =
+                    std::max(difference[target], GetDifference(matricesOut.Get(i), rotationMatrices[i]));
+            }
+        }
+
+        features = detected;
+
+        std::printf("%zu elements, best of %d runs, microseconds per call\n%-10s %12s", count, BENCH_RUNS, "kernel",
+                    "per-element");
+        for(const BenchTarget& target : targets) std::printf(" %10s", target.Name);
+
+        const char* kernels[4] = {"transform", "multiply", "normalize", "to matrix"};
+        for(int kernel = 0; kernel < 4; ++kernel) {
+            std::printf("\n%-10s %12.3f", kernels[kernel], each[kernel]);
+            for(std::size_t target = 0; target < targets.size(); ++target) {
+                std::printf(" %10.3f", batched[kernel][target]);
+            }
+        }
+
+        std::printf("\n%-10s %12s", "max diff", "");
+        for(std::size_t target = 0; target < targets.size(); ++target) std::printf(" %10.2g", difference[target]);
+        std::printf("\n");
+        return 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../World.hpp"
+#include "../graphics/FrameBuffer.hpp"
+#include "../graphics/Rasterizer.hpp"
+#include "../io/Image.hpp"
+
+namespace regression {
+    constexpr inline int TIMING_RUNS = 21;
+
+    // Reference images committed with the scenes, relative to the repository root
+    constexpr inline const char* GOLDEN_DIRECTORY = "regression/golden";
+
+    // Budget is the median frame time allowed as a multiple of the calibration scene's, so it holds on any machine
+    struct Scene {
+        const char* Name;
+        double Budget;
+        void (*Draw)(graphics::FrameBuffer& frame);
+    };
+
+    struct Options {
+        std::uint32_t Tolerance = 1;
+        std::size_t AllowedMismatches = 0;
+        double BudgetScale = 1.0;
+        bool Update = false;
+    };
+
+    struct SceneResult {
+        bool HasGolden = false;
+        io::ImageDiff Diff;
+        double FrameMs = 0.0;
+        double BudgetMs = 0.0;
+        bool Passed = false;
+    };
+
+    inline shader::Default GetCamera(const float angle) {
+        return {world::GetMVP(angle),
+                math::CreateViewport(static_cast<float>(world::WIDTH), static_cast<float>(world::HEIGHT))};
+    }
+
+    // A floor tessellated from far in front of the camera to behind it. The eye is at z = 5 and the near plane at
+    // z = 4.9: every triangle touching the 4.95 row is rejected whole, as nothing clips, and that includes each one
+    // reaching behind the eye, while the rows up to 4.5 lie fully in front and must still draw
+    inline void DrawNearPlane(graphics::FrameBuffer& frame) {
+        constexpr float rows[] = {-30.f, -20.f, -12.f, -6.f, -2.f, 1.f, 3.f, 4.5f, 4.95f, 8.f};
+        constexpr int columns = 5;
+        constexpr int rowCount = static_cast<int>(std::size(rows));
+
+        // Corner colors red, green, blue and white as before, blended across the grid
+        std::vector<shader::Vertex> vertices;
+        for(const float z : rows) {
+            const float v = (z - rows[0]) / (rows[rowCount - 1] - rows[0]);
+            for(int column = 0; column < columns; ++column) {
+                const float u = static_cast<float>(column) / (columns - 1);
+                vertices.push_back({{8.f * u - 4.f, -1.f, z, 1.f}, {1.f - u, u * (1.f - v) + (1.f - u) * v, v, 1.f}});
+            }
+        }
+
+        std::vector<std::uint32_t> indices;
+        for(int row = 0; row + 1 < rowCount; ++row) {
+            for(int column = 0; column + 1 < columns; ++column) {
+                const std::uint32_t first = static_cast<std::uint32_t>(row * columns + column);
+                const std::uint32_t next = first + columns;
+                indices.insert(indices.end(), {first, next + 1, first + 1, first, next, next + 1});
+            }
+        }
+
+        graphics::Render<graphics::PipelineState{.Cull = graphics::CullMode::None}>(frame, GetCamera(0.f), vertices,
+                                                                                     indices);
+        graphics::Render(frame, GetCamera(0.f), world::ModelVertices, world::ModelIndices);
+    }
+
+    // A disc fanned out of thin triangles, drawn additively: a pixel on a shared edge that is covered twice or
+    // not at all shows up as a seam
+    inline void DrawSharedEdges(graphics::FrameBuffer& frame) {
+        constexpr int slices = 97;
+        std::vector<shader::Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+
+        vertices.push_back({{0.f, 0.f, 0.f, 1.f}, {1.f, 1.f, 1.f, .25f}});
+        for(int i = 0; i < slices; ++i) {
+            const float angle = math::ToRadian(360.f * static_cast<float>(i) / slices);
+            vertices.push_back({{1.8f * std::cos(angle), 1.8f * std::sin(angle), 0.f, 1.f}, {1.f, 1.f, 1.f, .25f}});
+            indices.insert(indices.end(), {0u, static_cast<std::uint32_t>(1 + i),
+                                           static_cast<std::uint32_t>(1 + (i + 1) % slices)});
+        }
+
+        constexpr graphics::PipelineState additive{.Cull = graphics::CullMode::None,
+                                                   .Depth = graphics::DepthFunc::Always,
+                                                   .DepthWrite = false,
+                                                   .Blend = graphics::BlendMode::Additive};
+        graphics::Render<additive>(frame, GetCamera(0.f), vertices, indices);
+    }
+
+    inline void DrawPointGrid(graphics::FrameBuffer& frame) {
+        std::vector<shader::Vertex> points;
+
+        for(int y = 0; y < 64; ++y) {
+            for(int x = 0; x < 64; ++x) {
+                const float u = static_cast<float>(x) / 63.f;
+                const float v = static_cast<float>(y) / 63.f;
+                points.push_back({{u * 4.f - 2.f, v * 4.f - 2.f, u - v, 1.f}, {u, v, 1.f - u, 1.f}});
+            }
+        }
+
+        graphics::Render(frame, GetCamera(0.5f), points, graphics::PrimitiveType::Points);
+    }
+
+    // Fills the whole frame with interpolated color once, a fixed amount of raster work to measure this machine by
+    inline void DrawCalibration(graphics::FrameBuffer& frame) {
+        static const std::vector<shader::Vertex> vertices = {
+            {{-1.f, -1.f, 0.5f, 1.f}, {1.f, 0.f, 0.f, 1.f}}, {{1.f, -1.f, 0.5f, 1.f}, {0.f, 1.f, 0.f, 1.f}},
+            {{1.f, 1.f, 0.5f, 1.f}, {0.f, 0.f, 1.f, 1.f}},   {{-1.f, 1.f, 0.5f, 1.f}, {1.f, 1.f, 1.f, 1.f}},
+        };
+        static const std::vector<std::uint32_t> indices = {0, 1, 2, 0, 2, 3};
+
+        const shader::Default fullScreen{
+            math::Matrix{}, math::CreateViewport(static_cast<float>(world::WIDTH), static_cast<float>(world::HEIGHT))};
+        constexpr graphics::PipelineState state{.Cull = graphics::CullMode::None, .Depth = graphics::DepthFunc::Always};
+
+        graphics::Render<state>(frame, fullScreen, vertices, indices);
+    }
+
+    inline const std::vector<Scene>& GetScenes() {
+        static const std::vector<Scene> scenes = {
+            {"cube", 0.6,
+             [](graphics::FrameBuffer& frame) {
+                 graphics::Render(frame, GetCamera(0.6f), world::ModelVertices, world::ModelIndices);
+             }},
+            {"cube_lines", 0.3,
+             [](graphics::FrameBuffer& frame) {
+                 graphics::Render(frame, GetCamera(0.6f), world::ModelVertices, world::ModelIndices,
+                                  graphics::PrimitiveType::Lines);
+             }},
+            {"near_plane", 1.5, DrawNearPlane},
+            {"shared_edges", 1.2, DrawSharedEdges},
+            {"point_grid", 0.3, DrawPointGrid},
+        };
+        return scenes;
+    }
+
+    // Median time of TIMING_RUNS cleared and redrawn frames
+    inline double MeasureFrameMs(graphics::FrameBuffer& frame, void (*draw)(graphics::FrameBuffer& frame)) {
+        std::vector<double> times(TIMING_RUNS);
+        for(double& time : times) {
+            const auto start = std::chrono::steady_clock::now();
+            frame.Clear(world::COLOR);
+            draw(frame);
+            time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::nth_element(times.begin(), times.begin() + TIMING_RUNS / 2, times.end());
+        return times[TIMING_RUNS / 2];
+    }
+
+    // Renders the scene once for the image, then times it against calibrationMs times its budget. A missing
+    // reference fails the scene; only Options::Update writes one
+    inline SceneResult RunScene(const Scene& scene, const std::string& directory, const double calibrationMs,
+                                const Options& options) {
+        SceneResult result;
+        graphics::FrameBuffer frame(world::WIDTH, world::HEIGHT);
+
+        frame.Clear(world::COLOR);
+        scene.Draw(frame);
+
+        const std::vector<std::uint32_t> image(frame.GetColor(), frame.GetColor() + world::WIDTH * world::HEIGHT);
+        const std::string path = directory + "/" + scene.Name + ".ppm";
+
+        if(options.Update) {
+            result.HasGolden = io::WriteImage(path.c_str(), image.data(), world::WIDTH, world::HEIGHT);
+        } else {
+            std::vector<std::uint32_t> golden;
+            std::uint32_t width = 0;
+            std::uint32_t height = 0;
+
+            result.HasGolden = io::ReadImage(path.c_str(), golden, width, height) && width == world::WIDTH &&
+                               height == world::HEIGHT;
+            if(result.HasGolden)
+                result.Diff = io::CompareImages(image.data(), golden.data(), image.size(), options.Tolerance);
+        }
+
+        result.FrameMs = MeasureFrameMs(frame, scene.Draw);
+        result.BudgetMs = scene.Budget * calibrationMs * options.BudgetScale;
+
+        const bool matches = result.HasGolden && result.Diff.Mismatches <= options.AllowedMismatches;
+        result.Passed = matches && result.FrameMs <= result.BudgetMs;
+        return result;
+    }
+
+    // Checks every scene against <directory>/<name>.ppm, or rewrites those images with Options::Update;
+    // returns the number of failing scenes
+    inline int RunGolden(const std::string& directory = GOLDEN_DIRECTORY, const Options& options = {}) {
+        int failures = 0;
+
+        graphics::FrameBuffer frame(world::WIDTH, world::HEIGHT);
+        const double calibrationMs = MeasureFrameMs(frame, DrawCalibration);
+        std::printf("%-14s %.3f ms\n", "calibration", calibrationMs);
+
+        for(const Scene& scene : GetScenes()) {
+            const SceneResult result = RunScene(scene, directory, calibrationMs, options);
+            const double budget = result.BudgetMs;
+
+            if(!result.HasGolden) {
+                std::printf("%-14s %s\n", scene.Name, options.Update ? "cannot write image" : "missing golden image");
+            } else {
+                std::printf("%-14s %s  diff %zu px (max %u)  %.3f / %.3f ms\n", scene.Name,
+                            result.Passed ? "ok  " : "FAIL", result.Diff.Mismatches, result.Diff.MaxError,
+                            result.FrameMs, budget);
+            }
+
+            if(!result.Passed) ++failures;
+        }
+
+        return failures;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,352 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../graphics/Blend.hpp"
+#include "../graphics/TriangleSetup.hpp"
+#include "../io/Video.hpp"
+#include "../math/SIMD.hpp"
+
+namespace regression {
+    constexpr inline std::uint32_t SIMD_CHECK_SEED = 20240607u;
+    constexpr inline int SIMD_CHECK_ROUNDS = 2000;
+
+    struct SimdResult {
+        std::size_t Cases = 0;
+        std::size_t Failures = 0;
+
+        inline void Expect(const bool passed) noexcept {
+            ++Cases;
+            if(!passed) ++Failures;
+        }
+    };
+
+    inline std::array<float, 4> GetLanes(const simd::Floats& val) noexcept {
+        std::array<float, 4> lanes;
+        simd::Store(lanes.data(), val);
+        return lanes;
+    }
+
+    // Bitwise equal, except that any NaN matches any other: x86 and ARM produce different default NaNs
+    inline bool IsSame(const float a, const float b) noexcept {
+        return (std::isnan(a) && std::isnan(b)) || std::bit_cast<std::uint32_t>(a) == std::bit_cast<std::uint32_t>(b);
+    }
+
+    template <std::uint8_t MASK>
+    inline void CheckShuffle(const std::array<float, 4>& a, const std::array<float, 4>& b, SimdResult& result) {
+        const std::array<float, 4> shuffled = GetLanes(simd::Shuffle<MASK>(simd::Load(a.data()), simd::Load(b.data())));
+        const std::array<float, 4> swizzled = GetLanes(simd::Swizzle<MASK>(simd::Load(a.data())));
+
+        for(int i = 0; i < 4; ++i) {
+            const int source = (MASK >> (2 * i)) & 3;
+            result.Expect(IsSame(shuffled[i], i < 2 ? a[source] : b[source]) && IsSame(swizzled[i], a[source]));
+        }
+    }
+
+    // The products may be summed in any order, so the sum only has to land within rounding of the scalar one
+    template <std::uint8_t MASK>
+    inline void CheckHorizonSum(const std::array<float, 4>& a, const std::array<float, 4>& b, SimdResult& result) {
+        const std::array<float, 4> sum = GetLanes(simd::HorizonSum<MASK>(simd::Load(a.data()), simd::Load(b.data())));
+
+        float expected = 0.f;
+        float magnitude = 0.f;
+        for(int i = 0; i < 4; ++i) {
+            if(!((MASK >> (4 + i)) & 1)) continue;
+            expected += a[i] * b[i];
+            magnitude += std::abs(a[i] * b[i]);
+        }
+
+        for(int i = 0; i < 4; ++i) {
+            if((MASK >> i) & 1) {
+                result.Expect(std::abs(sum[i] - expected) <= magnitude * 1e-6f);
+            } else {
+                result.Expect(sum[i] == 0.f);
+            }
+        }
+    }
+
+    // Every simd:: operation against the same operation on each lane; only Reciprocal and HorizonSum are inexact
+    inline SimdResult CheckFloats(std::mt19937& rng) {
+        SimdResult result;
+        std::uniform_real_distribution<float> value(-1000.f, 1000.f);
+
+        // Ties, negative zero, and magnitudes past 2^23 that are already integral
+        const float specials[] = {0.5f, -0.5f, 1.5f, -2.5f, -0.f, 0.49999997f, 8388607.5f, -8388609.f, 3e9f, -1e15f};
+
+        for(int round = 0; round < SIMD_CHECK_ROUNDS; ++round) {
+            std::array<float, 4> a;
+            std::array<float, 4> b;
+            for(int i = 0; i < 4; ++i) {
+                a[i] = rng() % 4 == 0 ? specials[rng() % std::size(specials)] : value(rng);
+                b[i] = rng() % 8 == 0 ? a[i] : value(rng);
+            }
+
+            const simd::Floats lhs = simd::Load(a.data());
+            const simd::Floats rhs = simd::Load(b.data());
+
+            const std::array<float, 4> sum = GetLanes(simd::Add(lhs, rhs));
+            const std::array<float, 4> difference = GetLanes(simd::Sub(lhs, rhs));
+            const std::array<float, 4> product = GetLanes(simd::Mul(lhs, rhs));
+            const std::array<float, 4> quotient = GetLanes(simd::Div(lhs, rhs));
+            const std::array<float, 4> root = GetLanes(simd::Sqrt(simd::Mul(lhs, lhs)));
+            const std::array<float, 4> rounded = GetLanes(simd::Round(lhs));
+            const std::array<float, 4> reciprocal = GetLanes(simd::Reciprocal(rhs));
+            const std::array<float, 4> less = GetLanes(simd::Less(lhs, rhs));
+            const std::array<float, 4> lessEqual = GetLanes(simd::LessEqual(lhs, rhs));
+            const std::array<float, 4> bitAnd = GetLanes(simd::And(lhs, rhs));
+            const std::array<float, 4> bitXor = GetLanes(simd::Xor(lhs, rhs));
+
+            const std::array<float, 8> wideLanes = {a[0], a[1], a[2], a[3], b[0], b[1], b[2], b[3]};
+            const simd::Floats8 wide = simd::Load8(wideLanes.data());
+            std::array<float, 8> wideRounded;
+            simd::Store(wideRounded.data(), simd::Round(wide));
+
+            int mask = 0;
+            for(int i = 0; i < 4; ++i) {
+                const std::uint32_t lhsBits = std::bit_cast<std::uint32_t>(a[i]);
+                const std::uint32_t rhsBits = std::bit_cast<std::uint32_t>(b[i]);
+                mask |= static_cast<int>(lhsBits >> 31) << i;
+
+                result.Expect(IsSame(sum[i], a[i] + b[i]));
+                result.Expect(IsSame(difference[i], a[i] - b[i]));
+                result.Expect(IsSame(product[i], a[i] * b[i]));
+                result.Expect(IsSame(quotient[i], a[i] / b[i]));
+                result.Expect(IsSame(root[i], std::sqrt(a[i] * a[i])));
+                result.Expect(IsSame(rounded[i], std::round(a[i])));
+                result.Expect(IsSame(wideRounded[i], std::round(a[i])) &&
+                              IsSame(wideRounded[i + 4], std::round(b[i])));
+                result.Expect(b[i] == 0.f || std::abs(reciprocal[i] * b[i] - 1.f) < 1e-3f);
+                result.Expect(std::bit_cast<std::uint32_t>(less[i]) == (a[i] < b[i] ? ~0u : 0u));
+                result.Expect(std::bit_cast<std::uint32_t>(lessEqual[i]) == (a[i] <= b[i] ? ~0u : 0u));
+                result.Expect(std::bit_cast<std::uint32_t>(bitAnd[i]) == (lhsBits & rhsBits));
+                result.Expect(std::bit_cast<std::uint32_t>(bitXor[i]) == (lhsBits ^ rhsBits));
+            }
+
+            result.Expect(simd::GetMask(lhs) == mask);
+            result.Expect(simd::GetMask(wide) == (mask | simd::GetMask(rhs) << 4));
+            result.Expect(IsSame(simd::GetFirst(lhs), a[0]));
+            result.Expect(simd::AllClose(lhs, lhs) && simd::AllClose(lhs, rhs) == (a == b));
+
+            const std::array<float, 4> high = GetLanes(simd::UnpackHigh(lhs, rhs));
+            const std::array<float, 4> low = GetLanes(simd::UnpackLow(lhs, rhs));
+            const std::array<float, 4> lowHigh = GetLanes(simd::PackLowHigh(lhs, rhs));
+            const std::array<float, 4> highLow = GetLanes(simd::PackHighLow(lhs, rhs));
+            result.Expect(high == std::array<float, 4>{a[2], b[2], a[3], b[3]});
+            result.Expect(low == std::array<float, 4>{a[0], b[0], a[1], b[1]});
+            result.Expect(lowHigh == std::array<float, 4>{a[0], a[1], b[0], b[1]});
+            result.Expect(highLow == std::array<float, 4>{b[2], b[3], a[2], a[3]});
+            result.Expect(GetLanes(simd::Set(a[0], a[1], a[2], a[3])) == a);
+            result.Expect(GetLanes(simd::Set(a[1])) == std::array<float, 4>{a[1], a[1], a[1], a[1]});
+            result.Expect(GetLanes(simd::Reset()) == std::array<float, 4>{});
+
+            CheckShuffle<_MM_SHUFFLE(3, 2, 1, 0)>(a, b, result);
+            CheckShuffle<_MM_SHUFFLE(0, 1, 2, 3)>(a, b, result);
+            CheckShuffle<_MM_SHUFFLE(1, 0, 3, 2)>(a, b, result);
+            CheckShuffle<_MM_SHUFFLE(2, 0, 3, 1)>(a, b, result);
+            CheckShuffle<_MM_SHUFFLE(3, 3, 0, 0)>(a, b, result);
+
+            CheckHorizonSum<0xFF>(a, b, result);
+            CheckHorizonSum<0x7F>(a, b, result);
+            CheckHorizonSum<0x71>(a, b, result);
+            CheckHorizonSum<0xB4>(a, b, result);
+        }
+
+        return result;
+    }
+
+    template <graphics::CullMode Cull>
+    inline void CheckSetup(const std::vector<shader::Vertex>& vertices, const std::vector<std::uint32_t>& indices,
+                           const graphics::BoundingBox& clip, SimdResult& result) {
+        const std::size_t triangleCount = indices.size() / 3;
+        std::vector<graphics::TriangleSetup> expected(triangleCount);
+        std::vector<graphics::TriangleSetup> batched(triangleCount);
+
+        std::size_t expectedCount = 0;
+        for(std::size_t t = 0; t < triangleCount; ++t) {
+            if(graphics::SetupTriangle<Cull>(vertices[indices[3 * t]], vertices[indices[3 * t + 1]],
+                                             vertices[indices[3 * t + 2]], clip, expected[expectedCount])) {
+                ++expectedCount;
+            }
+        }
+
+        const std::size_t count = graphics::SetupTriangles<Cull>(vertices.data(), vertices.size(), indices.data(),
+                                                                 triangleCount, clip, batched.data());
+        result.Expect(count == expectedCount);
+
+        for(std::size_t i = 0; i < std::min(count, expectedCount); ++i) {
+            const graphics::TriangleSetup& a = expected[i];
+            const graphics::TriangleSetup& b = batched[i];
+
+            bool same = IsSame(a.InvArea, b.InvArea) && a.Bound.MinX == b.Bound.MinX &&
+                        a.Bound.MaxX == b.Bound.MaxX && a.Bound.MinY == b.Bound.MinY && a.Bound.MaxY == b.Bound.MaxY;
+            for(int k = 0; k < 3; ++k) {
+                same = same && a.Vertices[k] == b.Vertices[k] && a.Edges[k].A == b.Edges[k].A &&
+                       a.Edges[k].B == b.Edges[k].B && a.Edges[k].C == b.Edges[k].C;
+            }
+            result.Expect(same);
+        }
+    }
+
+    // SetupTriangles against SetupTriangle one triangle at a time, with corners on rounding ties, behind the camera,
+    // outside the guard band and far enough apart to take the wide-area fallback
+    inline SimdResult CheckTriangleSetup(std::mt19937& rng) {
+        SimdResult result;
+        std::uniform_real_distribution<float> screen(-64.f, 704.f);
+        std::uniform_real_distribution<float> far(-3e7f, 3e7f);
+
+        for(int round = 0; round < SIMD_CHECK_ROUNDS / 10; ++round) {
+            std::vector<shader::Vertex> vertices(64);
+            for(shader::Vertex& vertex : vertices) {
+                const unsigned kind = rng() % 8;
+                float x = screen(rng);
+                float y = screen(rng) * 0.5625f;
+
+                if(kind == 0) {
+                    x = std::round(x * 16.f) / 16.f + 1.f / 32.f;
+                    y = std::round(y * 16.f) / 16.f - 1.f / 32.f;
+                } else if(kind == 1) {
+                    x = far(rng);
+                    y = far(rng);
+                }
+
+                vertex.Pos = math::Vector(x, y, rng() % 16 == 0 ? -0.25f : 0.5f, 1.f);
+            }
+
+            std::vector<std::uint32_t> indices(3 * (1 + rng() % 64));
+            for(std::uint32_t& index : indices) index = static_cast<std::uint32_t>(rng() % vertices.size());
+            for(std::size_t t = 0; t + 2 < indices.size(); t += 15) indices[t + 2] = indices[t];
+
+            const graphics::BoundingBox clip =
+                round % 2 == 0 ? graphics::GetFullRect(640, 360) : graphics::BoundingBox{96, 480, 40, 300, true};
+            CheckSetup<graphics::CullMode::Back>(vertices, indices, clip, result);
+            CheckSetup<graphics::CullMode::Front>(vertices, indices, clip, result);
+            CheckSetup<graphics::CullMode::None>(vertices, indices, clip, result);
+        }
+
+        return result;
+    }
+
+    template <graphics::BlendMode Mode>
+    inline void CheckBlend(const std::vector<std::uint32_t>& src, const std::vector<std::uint32_t>& dst,
+                           const std::uint32_t mask, SimdResult& result) {
+        const std::uint32_t count = static_cast<std::uint32_t>(src.size());
+        std::vector<std::uint32_t> blended = dst;
+        graphics::BlendPixels<Mode>(blended.data(), src.data(), count, mask);
+
+        for(std::uint32_t i = 0; i < count; ++i) {
+            const bool covered = (mask >> i) & 1u;
+            result.Expect(blended[i] == (covered ? graphics::BlendPixel<Mode>(src[i], dst[i]) : dst[i]));
+        }
+    }
+
+    // The packed blend kernels against BlendPixel, with opaque and fully transparent sources mixed in
+    inline SimdResult CheckBlending(std::mt19937& rng) {
+        SimdResult result;
+
+        for(int round = 0; round < SIMD_CHECK_ROUNDS; ++round) {
+            const std::uint32_t count = 1 + rng() % 32;
+            std::vector<std::uint32_t> src(count);
+            std::vector<std::uint32_t> dst(count);
+
+            for(std::uint32_t i = 0; i < count; ++i) {
+                const unsigned kind = rng() % 4;
+                src[i] = kind == 0 ? rng() | 0xFF000000u : kind == 1 ? rng() & 0x00FFFFFFu : rng();
+                dst[i] = rng();
+            }
+
+            const std::uint32_t mask = rng() % 4 == 0 ? ~0u : static_cast<std::uint32_t>(rng());
+            CheckBlend<graphics::BlendMode::Alpha>(src, dst, mask, result);
+            CheckBlend<graphics::BlendMode::Additive>(src, dst, mask, result);
+            CheckBlend<graphics::BlendMode::Premultiplied>(src, dst, mask, result);
+        }
+
+        return result;
+    }
+
+    // The I420 row kernels against the per-pixel formulas, at widths covering the SIMD blocks and every tail
+    inline SimdResult CheckVideo(std::mt19937& rng) {
+        SimdResult result;
+
+        for(int round = 0; round < SIMD_CHECK_ROUNDS / 10; ++round) {
+            const std::uint32_t width = 1 + rng() % 80;
+            const std::uint32_t chromaWidth = (width + 1) / 2;
+
+            std::vector<std::uint32_t> rows[2] = {std::vector<std::uint32_t>(width), std::vector<std::uint32_t>(width)};
+            for(std::vector<std::uint32_t>& row : rows) {
+                for(std::uint32_t& pixel : row) pixel = rng() % 8 == 0 ? (rng() % 2 ? ~0u : 0xFF000000u) : rng();
+            }
+
+            std::vector<std::uint8_t> luma(width);
+            std::vector<std::uint8_t> u(chromaWidth);
+            std::vector<std::uint8_t> v(chromaWidth);
+            io::ConvertLumaRow(rows[0].data(), luma.data(), width);
+            io::ConvertChromaRow(rows[0].data(), rows[1].data(), u.data(), v.data(), width);
+
+            for(std::uint32_t x = 0; x < width; ++x) {
+                const std::uint32_t c = rows[0][x];
+                result.Expect(luma[x] == io::ToLuma(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF));
+            }
+
+            for(std::uint32_t x = 0; x < chromaWidth; ++x) {
+                const std::uint32_t right = std::min(2 * x + 1, width - 1);
+                const std::uint32_t block[4] = {rows[0][2 * x], rows[0][right], rows[1][2 * x], rows[1][right]};
+
+                int means[3];
+                for(int channel = 0; channel < 3; ++channel) {
+                    int sum = 0;
+                    for(const std::uint32_t c : block) sum += (c >> (8 * channel)) & 0xFF;
+                    means[channel] = (sum + 2) >> 2;
+                }
+
+                result.Expect(u[x] == io::ToChromaU(means[0], means[1], means[2]) &&
+                              v[x] == io::ToChromaV(means[0], means[1], means[2]));
+            }
+        }
+
+        return result;
+    }
+
+    // Runs every SIMD path of this build against the scalar code it replaces and prints one line per group; returns
+    // the number of failing groups
+    inline int RunSimdCheck() {
+#ifdef ENGINE_SIMD_SSE
+        const char* backend = "sse";
+#elif defined(ENGINE_SIMD_NEON)
+        const char* backend = "neon";
+#else
+        const char* backend = "scalar";
+#endif
+        std::printf("%-14s %s\n", "backend", backend);
+
+        struct Group {
+            const char* Name;
+            SimdResult (*Check)(std::mt19937& rng);
+        };
+        const Group groups[] = {
+            {"floats", CheckFloats},
+            {"setup", CheckTriangleSetup},
+            {"blend", CheckBlending},
+            {"i420", CheckVideo},
+        };
+
+        int failures = 0;
+        for(const Group& group : groups) {
+            std::mt19937 rng(SIMD_CHECK_SEED);
+            const SimdResult result = group.Check(rng);
+
+            std::printf("%-14s %s  %zu of %zu cases failed\n", group.Name, result.Failures == 0 ? "ok  " : "FAIL",
+                        result.Failures, result.Cases);
+            if(result.Failures != 0) ++failures;
+        }
+
+        return failures;
+    }
+}
\ No newline at end of file